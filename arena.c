@@ -0,0 +1,100 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define POEMGR_ARENA_ALIGN	alignof(max_align_t)
+
+static size_t poemgr_arena_align(size_t size)
+{
+	return (size + POEMGR_ARENA_ALIGN - 1) & ~(POEMGR_ARENA_ALIGN - 1);
+}
+
+static struct poemgr_arena_chunk *poemgr_arena_chunk_new(struct poemgr_arena *arena, size_t size)
+{
+	struct poemgr_arena_chunk **tail = &arena->chunks;
+	struct poemgr_arena_chunk *chunk;
+
+	if (size < POEMGR_ARENA_CHUNK_SIZE)
+		size = POEMGR_ARENA_CHUNK_SIZE;
+
+	chunk = malloc(sizeof(*chunk) + size);
+	if (!chunk)
+		return NULL;
+
+	chunk->size = size;
+	chunk->used = 0;
+	chunk->next = NULL;
+
+	/*
+	 * Append, so the same sequence of allocations ends up in the same
+	 * chunks after a reset and no new chunk is required.
+	 */
+	while (*tail)
+		tail = &(*tail)->next;
+	*tail = chunk;
+
+	return chunk;
+}
+
+void *poemgr_arena_alloc(struct poemgr_arena *arena, size_t size)
+{
+	struct poemgr_arena_chunk *chunk;
+	void *ptr;
+
+	size = poemgr_arena_align(size);
+
+	/* Use the first chunk with enough space left, chunks are reused after reset */
+	for (chunk = arena->chunks; chunk; chunk = chunk->next) {
+		if (chunk->size - chunk->used >= size)
+			break;
+	}
+
+	if (!chunk) {
+		chunk = poemgr_arena_chunk_new(arena, size);
+		if (!chunk)
+			return NULL;
+	}
+
+	ptr = &chunk->data[chunk->used];
+	chunk->used += size;
+
+	memset(ptr, 0, size);
+	return ptr;
+}
+
+char *poemgr_arena_strdup(struct poemgr_arena *arena, const char *s)
+{
+	size_t len = strlen(s) + 1;
+	char *ptr;
+
+	ptr = poemgr_arena_alloc(arena, len);
+	if (!ptr)
+		return NULL;
+
+	memcpy(ptr, s, len);
+	return ptr;
+}
+
+void poemgr_arena_reset(struct poemgr_arena *arena)
+{
+	struct poemgr_arena_chunk *chunk;
+
+	for (chunk = arena->chunks; chunk; chunk = chunk->next)
+		chunk->used = 0;
+}
+
+void poemgr_arena_free(struct poemgr_arena *arena)
+{
+	struct poemgr_arena_chunk *chunk, *next;
+
+	for (chunk = arena->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+
+	arena->chunks = NULL;
+}
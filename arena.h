@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include <stddef.h>
+
+#define POEMGR_ARENA_CHUNK_SIZE		4096
+
+struct poemgr_arena_chunk {
+	struct poemgr_arena_chunk *next;
+	size_t size;
+	size_t used;
+	char data[];
+};
+
+/**
+ * Bump allocator for allocations living as long as one configuration
+ * generation. Everything is released at once using poemgr_arena_reset(),
+ * which keeps the chunks for the next generation.
+ */
+struct poemgr_arena {
+	struct poemgr_arena_chunk *chunks;
+};
+
+void *poemgr_arena_alloc(struct poemgr_arena *arena, size_t size);
+
+char *poemgr_arena_strdup(struct poemgr_arena *arena, const char *s);
+
+void poemgr_arena_reset(struct poemgr_arena *arena);
+
+void poemgr_arena_free(struct poemgr_arena *arena);
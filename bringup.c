@@ -0,0 +1,369 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bringup.h"
+#include "scheduler.h"
+#include "thermal.h"
+#include "trace.h"
+
+/**
+ * Switching on all ports at once lets the detection and inrush of all PDs
+ * coincide, which can exceed a small power budget. Ports which are not
+ * powered yet are held off while applying the configuration and are switched
+ * on one at a time: Higher priority ports first, within a priority lower
+ * classes first. The next port is switched on once the previous one reached
+ * power-good (or no valid PD was detected) and the remaining power budget
+ * covers its class. Ports held off report no class, so the class of the PD
+ * last seen on the port is used. Ports without a known class only wait for
+ * the previous port, the PSE power management has the final say on them.
+ *
+ * The bring-up advances in short steps without blocking. The daemon runs them
+ * from its loop, so polling and requests go on meanwhile, the command line
+ * waits for the bring-up to finish.
+ *
+ * The bring-up polls the ports into its own copy of their status. The status
+ * in the context is left to the daemon, which would otherwise miss the
+ * transitions of the ports brought up.
+ */
+
+#define POEMGR_BRINGUP_DETECTION_FAULTS \
+	(POEMGR_FAULT_TYPE_SHORT_CIRCUIT | POEMGR_FAULT_TYPE_RESISTANCE_TOO_LOW | \
+	 POEMGR_FAULT_TYPE_RESISTANCE_TOO_HIGH | POEMGR_FAULT_TYPE_CAPACITY_TOO_HIGH | \
+	 POEMGR_FAULT_TYPE_OPEN_CIRCUIT)
+
+/* Maximum power at the PSE (watts) by class */
+static int poemgr_bringup_class_power(int poe_class)
+{
+	switch (poe_class) {
+		case 1:
+			return 4;
+		case 2:
+			return 7;
+		case 4:
+			return 30;
+		case 0:
+		case 3:
+		default:
+			return 15;
+	}
+}
+
+/* Read the status of a port without updating the status in the context */
+static int poemgr_bringup_poll_port(struct poemgr_ctx *ctx, int port, struct poemgr_port_status *status)
+{
+	struct poemgr_port *p = &ctx->ports[port];
+	struct poemgr_port_status saved = p->status;
+	int ret;
+
+	ret = poemgr_update_port_status(ctx, port);
+	*status = p->status;
+	p->status = saved;
+
+	/* Reading the latched faults cleared them in the PSE */
+	p->unreported_faults |= status->latched_faults;
+
+	return ret;
+}
+
+/* Current class, or the class last seen while the port is held off. -1 if unknown */
+static int poemgr_bringup_port_class(struct poemgr_ctx *ctx, int port, const int *poe_class)
+{
+	return poe_class[port] >= 0 ? poe_class[port] : ctx->ports[port].last_poe_class;
+}
+
+static int poemgr_bringup_before(struct poemgr_ctx *ctx, const int *poe_class, int a, int b)
+{
+	struct poemgr_port *port_a = &ctx->ports[a], *port_b = &ctx->ports[b];
+	int class_a = poemgr_bringup_port_class(ctx, a, poe_class);
+	int class_b = poemgr_bringup_port_class(ctx, b, poe_class);
+
+	if (port_a->settings.priority != port_b->settings.priority)
+		return port_a->settings.priority > port_b->settings.priority;
+
+	/* Unknown classes last */
+	if (class_a < 0 || class_b < 0)
+		return class_a >= 0 && class_b < 0;
+
+	return poemgr_bringup_class_power(class_a) < poemgr_bringup_class_power(class_b);
+}
+
+/* Budget which has to be left before switching on the port (watts) */
+static int poemgr_bringup_required_power(struct poemgr_ctx *ctx, int port, const int *poe_class, int budget)
+{
+	int port_class = poemgr_bringup_port_class(ctx, port, poe_class);
+	int power;
+
+	if (port_class < 0)
+		return 0;
+
+	/* A PD drawing more than the budget is limited by the PSE anyway */
+	power = poemgr_bringup_class_power(port_class);
+	return power < budget ? power : budget;
+}
+
+/* Power drawn by the powered ports (watts) */
+static int poemgr_bringup_consumption(struct poemgr_ctx *ctx, uint32_t powered)
+{
+	struct poemgr_port_status status;
+	int consumption = 0;
+
+	for (int i = 0; i < poemgr_profile_num_ports(ctx); i++) {
+		if (!(powered & (1 << i)))
+			continue;
+
+		if (poemgr_bringup_poll_port(ctx, i, &status))
+			return -1;
+
+		consumption += status.power;
+	}
+
+	return consumption;
+}
+
+/* Port is to be switched on by configuration, which may have changed since the bring-up started */
+static int poemgr_bringup_port_wanted(struct poemgr_ctx *ctx, int port)
+{
+	struct poemgr_port_settings *settings = &ctx->ports[port].settings;
+
+	return settings->name && !settings->disabled && !poemgr_thermal_port_shed(ctx, port);
+}
+
+uint32_t poemgr_bringup_pending(struct poemgr_ctx *ctx)
+{
+	uint32_t pending = 0;
+	int powered;
+
+	if (!poemgr_profile_has_cb(ctx, set_ports_power) || !poemgr_profile_has_cb(ctx, get_ports_power_good))
+		return 0;
+
+	/* PSE not accessible, switch on all ports at once */
+	powered = poemgr_profile_cb(ctx, get_ports_power_good)(ctx);
+	if (powered < 0)
+		return 0;
+
+	for (int i = 0; i < poemgr_profile_num_ports(ctx); i++) {
+		if (poemgr_bringup_port_wanted(ctx, i) && !(powered & (1 << i)))
+			pending |= 1 << i;
+	}
+
+	return pending;
+}
+
+/* Power budget of the PSE (watts), -1 on error */
+static int poemgr_bringup_budget(struct poemgr_ctx *ctx)
+{
+	struct poemgr_output_status saved = ctx->output_status;
+	int budget;
+
+	if (poemgr_profile_cb(ctx, update_output_status)(ctx))
+		return -1;
+
+	budget = ctx->output_status.power_budget;
+	ctx->output_status = saved;
+
+	return budget;
+}
+
+/* Make the next port in order the current one */
+static void poemgr_bringup_next(struct poemgr_ctx *ctx, int64_t now)
+{
+	struct poemgr_bringup *bringup = &ctx->bringup;
+	int port = bringup->order[bringup->current];
+
+	poemgr_trace_end(bringup->span, "bringup", "port", 2, "port", port,
+			 "time_to_power", ctx->ports[port].status.time_to_power);
+
+	bringup->current++;
+	bringup->switched_on = 0;
+	bringup->start = now;
+	bringup->last_consumption = -1;
+	bringup->span = poemgr_trace_begin();
+}
+
+/* Returns 1 once the port is switched on, 0 to check again later, -1 on error */
+static int poemgr_bringup_switch_on(struct poemgr_ctx *ctx, int port, int64_t now)
+{
+	struct poemgr_bringup *bringup = &ctx->bringup;
+	int consumption, required;
+
+	/* Wait for the inrush of the previous port to settle. The first port has
+	 * nothing to wait for, the PSE decides whether the budget suffices.
+	 */
+	required = poemgr_bringup_required_power(ctx, port, bringup->poe_class, bringup->budget);
+	if (bringup->current > 0 && required > 0) {
+		consumption = poemgr_bringup_consumption(ctx, bringup->powered);
+		if (consumption < 0)
+			return -1;
+
+		if (bringup->budget - consumption < required) {
+			/* Only a settling inrush frees up budget, leave the decision to the power management of the PSE */
+			if ((bringup->last_consumption < 0 || consumption < bringup->last_consumption) &&
+			    now - bringup->start < POEMGR_BRINGUP_TIMEOUT) {
+				bringup->last_consumption = consumption;
+				return 0;
+			}
+
+			fprintf(stderr, "Insufficient power budget for port %s\n", ctx->ports[port].settings.name);
+		}
+	}
+
+	if (poemgr_profile_cb(ctx, set_ports_power)(ctx, 1 << port, 1))
+		return -1;
+
+	bringup->switched_on = 1;
+	bringup->start = now;
+
+	/* Let the daemon follow detection and classification */
+	poemgr_sched_port_due(ctx, port, now);
+
+	return 1;
+}
+
+/* Returns 1 once the port is powered or given up on, 0 to check again later, -1 on error */
+static int poemgr_bringup_wait_power(struct poemgr_ctx *ctx, int port, int64_t now)
+{
+	struct poemgr_bringup *bringup = &ctx->bringup;
+	struct poemgr_port_status status;
+
+	if (poemgr_bringup_poll_port(ctx, port, &status))
+		return -1;
+
+	if (status.active) {
+		ctx->ports[port].status.time_to_power = now - bringup->start > 0 ? now - bringup->start : 1;
+		bringup->powered |= 1 << port;
+		return 1;
+	}
+
+	/* No valid PD connected, the PSE keeps detecting on its own */
+	return status.faults & POEMGR_BRINGUP_DETECTION_FAULTS || now - bringup->start >= POEMGR_BRINGUP_TIMEOUT;
+}
+
+void poemgr_bringup_abort(struct poemgr_ctx *ctx)
+{
+	struct poemgr_bringup *bringup = &ctx->bringup;
+	uint32_t remaining = 0;
+
+	if (!bringup->active)
+		return;
+
+	bringup->active = 0;
+
+	for (int i = bringup->current; i < bringup->num_ports; i++) {
+		if (poemgr_bringup_port_wanted(ctx, bringup->order[i]))
+			remaining |= 1 << bringup->order[i];
+	}
+
+	if (remaining)
+		poemgr_profile_cb(ctx, set_ports_power)(ctx, remaining, 1);
+}
+
+/* Don't leave the remaining ports switched off */
+static void poemgr_bringup_fail(struct poemgr_ctx *ctx)
+{
+	fprintf(stderr, "Error during staggered port bring-up\n");
+
+	poemgr_bringup_abort(ctx);
+	ctx->bringup.error = 1;
+}
+
+int poemgr_bringup_start(struct poemgr_ctx *ctx, uint32_t pending)
+{
+	struct poemgr_bringup *bringup = &ctx->bringup;
+	struct poemgr_port_status status;
+	int ret, j;
+
+	/* A bring-up in progress is replaced, its remaining ports are pending again */
+	memset(bringup, 0, sizeof(*bringup));
+	if (!pending)
+		return 0;
+
+	/* Order by priority and last known class */
+	for (int i = 0; i < poemgr_profile_num_ports(ctx); i++) {
+		if (!(pending & (1 << i)))
+			continue;
+
+		ctx->ports[i].status.time_to_power = 0;
+		bringup->poe_class[i] = poemgr_bringup_poll_port(ctx, i, &status) ? -1 : status.poe_class;
+
+		for (j = bringup->num_ports;
+		     j > 0 && poemgr_bringup_before(ctx, bringup->poe_class, i, bringup->order[j - 1]); j--)
+			bringup->order[j] = bringup->order[j - 1];
+		bringup->order[j] = i;
+		bringup->num_ports++;
+	}
+
+	bringup->active = 1;
+	bringup->start = poemgr_time_ms();
+	bringup->last_consumption = -1;
+	bringup->span = poemgr_trace_begin();
+
+	bringup->budget = poemgr_bringup_budget(ctx);
+	ret = poemgr_profile_cb(ctx, get_ports_power_good)(ctx);
+	if (bringup->budget < 0 || ret < 0) {
+		poemgr_bringup_fail(ctx);
+		return 1;
+	}
+	bringup->powered = ret;
+
+	return 0;
+}
+
+int64_t poemgr_bringup_run(struct poemgr_ctx *ctx, int64_t now)
+{
+	struct poemgr_bringup *bringup = &ctx->bringup;
+	int port, ret;
+
+	if (!bringup->active)
+		return INT64_MAX;
+
+	if (now < bringup->next_update)
+		return bringup->next_update;
+
+	while (bringup->current < bringup->num_ports) {
+		port = bringup->order[bringup->current];
+
+		/* Disabled or shed since the bring-up started */
+		if (!bringup->switched_on && !poemgr_bringup_port_wanted(ctx, port)) {
+			poemgr_bringup_next(ctx, now);
+			continue;
+		}
+
+		if (!bringup->switched_on)
+			ret = poemgr_bringup_switch_on(ctx, port, now);
+		else if ((ret = poemgr_bringup_wait_power(ctx, port, now)) > 0)
+			poemgr_bringup_next(ctx, now);
+
+		if (ret < 0) {
+			poemgr_bringup_fail(ctx);
+			return INT64_MAX;
+		}
+
+		if (!ret) {
+			bringup->next_update = now + POEMGR_BRINGUP_POLL_INTERVAL;
+			return bringup->next_update;
+		}
+	}
+
+	bringup->active = 0;
+	return INT64_MAX;
+}
+
+int poemgr_bringup_wait(struct poemgr_ctx *ctx)
+{
+	int64_t now, next;
+
+	while (1) {
+		now = poemgr_time_ms();
+		next = poemgr_bringup_run(ctx, now);
+		if (next == INT64_MAX)
+			break;
+
+		if (next > now)
+			usleep((next - now) * 1000);
+	}
+
+	return ctx->bringup.error;
+}
@@ -0,0 +1,26 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "poemgr.h"
+
+/* Milliseconds */
+#define POEMGR_BRINGUP_TIMEOUT		5000	/* Per port */
+#define POEMGR_BRINGUP_POLL_INTERVAL	20
+
+/* Ports to be switched on which are not powered yet */
+uint32_t poemgr_bringup_pending(struct poemgr_ctx *ctx);
+
+/* Start switching on the pending ports one after the other, replacing a bring-up in progress */
+int poemgr_bringup_start(struct poemgr_ctx *ctx, uint32_t pending);
+
+/* Advance the bring-up without blocking. Returns when to call again, INT64_MAX once done */
+int64_t poemgr_bringup_run(struct poemgr_ctx *ctx, int64_t now);
+
+/* Finish the bring-up. Returns 1 if it failed */
+int poemgr_bringup_wait(struct poemgr_ctx *ctx);
+
+/* Switch on the remaining ports at once */
+void poemgr_bringup_abort(struct poemgr_ctx *ctx);
@@ -0,0 +1,209 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
+
+#define POEMGR_CACHE_EXE		"/proc/self/exe"
+
+const char *poemgr_cache_config_file = POEMGR_CONFIG_FILE;
+const char *poemgr_cache_config_delta_file = POEMGR_CONFIG_DELTA_FILE;
+const char *poemgr_cache_file = POEMGR_CACHE_FILE;
+
+static int poemgr_cache_file_id(const char *path, struct poemgr_cache_file_id *id)
+{
+	struct stat st;
+
+	if (stat(path, &st))
+		return -1;
+
+	id->dev = st.st_dev;
+	id->ino = st.st_ino;
+	id->size = st.st_size;
+	id->mtime_sec = st.st_mtim.tv_sec;
+	id->mtime_nsec = st.st_mtim.tv_nsec;
+
+	return 0;
+}
+
+static int poemgr_cache_file_id_equal(const struct poemgr_cache_file_id *a,
+				      const struct poemgr_cache_file_id *b)
+{
+	return a->dev == b->dev && a->ino == b->ino && a->size == b->size &&
+	       a->mtime_sec == b->mtime_sec && a->mtime_nsec == b->mtime_nsec;
+}
+
+static void poemgr_cache_init_header(struct poemgr_cache_header *hdr)
+{
+	hdr->magic = POEMGR_CACHE_MAGIC;
+	hdr->version = POEMGR_CACHE_VERSION;
+	hdr->size = sizeof(struct poemgr_cache);
+	hdr->settings_size = sizeof(struct poemgr_settings);
+	hdr->port_settings_size = sizeof(struct poemgr_port_settings);
+	hdr->max_ports = POEMGR_MAX_PORTS;
+}
+
+static int poemgr_cache_valid(const struct poemgr_cache *cache,
+			      const struct poemgr_cache_file_id *config,
+			      const struct poemgr_cache_file_id *exe)
+{
+	struct poemgr_cache_header hdr = {};
+	int i;
+
+	poemgr_cache_init_header(&hdr);
+
+	if (cache->hdr.magic != hdr.magic ||
+	    cache->hdr.version != hdr.version ||
+	    cache->hdr.size != hdr.size ||
+	    cache->hdr.settings_size != hdr.settings_size ||
+	    cache->hdr.port_settings_size != hdr.port_settings_size ||
+	    cache->hdr.max_ports != hdr.max_ports)
+		return 0;
+
+	/* Stale configuration, or structures written by a different binary */
+	if (!poemgr_cache_file_id_equal(&cache->hdr.config, config) ||
+	    !poemgr_cache_file_id_equal(&cache->hdr.exe, exe))
+		return 0;
+
+	if (cache->profile[POEMGR_CACHE_STR_LEN - 1])
+		return 0;
+
+	for (i = 0; i < POEMGR_MAX_PORTS; i++) {
+		if (cache->port_names[i][POEMGR_CACHE_STR_LEN - 1])
+			return 0;
+	}
+
+	return 1;
+}
+
+int poemgr_cache_load(struct poemgr_ctx *ctx, struct poemgr_cache_file_id *config)
+{
+	struct poemgr_cache_file_id id, exe;
+	const struct poemgr_cache *cache;
+	struct stat st;
+	int fd;
+	int i;
+
+	memset(config, 0, sizeof(*config));
+
+	/* Uncommitted changes are only visible through libuci */
+	if (!access(poemgr_cache_config_delta_file, F_OK))
+		return -1;
+
+	memset(&id, 0, sizeof(id));
+	memset(&exe, 0, sizeof(exe));
+	if (poemgr_cache_file_id(poemgr_cache_config_file, &id) ||
+	    poemgr_cache_file_id(POEMGR_CACHE_EXE, &exe))
+		return -1;
+
+	*config = id;
+
+	fd = open(poemgr_cache_file, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	/* Mapping beyond the end of the file faults on access */
+	if (fstat(fd, &st) || st.st_size != sizeof(*cache)) {
+		close(fd);
+		return -1;
+	}
+
+	cache = mmap(NULL, sizeof(*cache), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (cache == MAP_FAILED)
+		return -1;
+
+	if (!poemgr_cache_valid(cache, &id, &exe)) {
+		munmap((void *)cache, sizeof(*cache));
+		return -1;
+	}
+
+	ctx->settings = cache->settings;
+	ctx->settings.profile = (char *)cache->profile;
+
+	for (i = 0; i < POEMGR_MAX_PORTS; i++) {
+		ctx->ports[i].settings = cache->port_settings[i];
+		ctx->ports[i].settings.name = cache->port_names[i][0] ? (char *)cache->port_names[i] : NULL;
+	}
+
+	ctx->cache = cache;
+
+	return 0;
+}
+
+static int poemgr_cache_copy_string(char *dst, const char *src)
+{
+	size_t len = strlen(src);
+
+	/* Empty strings mark unset values */
+	if (!len || len >= POEMGR_CACHE_STR_LEN)
+		return -1;
+
+	memcpy(dst, src, len + 1);
+	return 0;
+}
+
+int poemgr_cache_store(struct poemgr_ctx *ctx, const struct poemgr_cache_file_id *config)
+{
+	struct poemgr_cache cache;
+	char tmp[PATH_MAX];
+	ssize_t len;
+	int fd;
+	int i;
+
+	if (!config->ino)
+		return -1;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", poemgr_cache_file) >= (int) sizeof(tmp))
+		return -1;
+
+	memset(&cache, 0, sizeof(cache));
+
+	poemgr_cache_init_header(&cache.hdr);
+	cache.hdr.config = *config;
+	if (poemgr_cache_file_id(POEMGR_CACHE_EXE, &cache.hdr.exe))
+		return -1;
+
+	cache.settings = ctx->settings;
+	cache.settings.profile = NULL;
+	if (poemgr_cache_copy_string(cache.profile, ctx->settings.profile))
+		return -1;
+
+	for (i = 0; i < POEMGR_MAX_PORTS; i++) {
+		cache.port_settings[i] = ctx->ports[i].settings;
+		cache.port_settings[i].name = NULL;
+
+		if (ctx->ports[i].settings.name &&
+		    poemgr_cache_copy_string(cache.port_names[i], ctx->ports[i].settings.name))
+			return -1;
+	}
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return -1;
+
+	len = write(fd, &cache, sizeof(cache));
+	close(fd);
+
+	if (len != sizeof(cache) || rename(tmp, poemgr_cache_file)) {
+		unlink(tmp);
+		return -1;
+	}
+
+	return 0;
+}
+
+void poemgr_cache_release(struct poemgr_ctx *ctx)
+{
+	if (!ctx->cache)
+		return;
+
+	munmap((void *)ctx->cache, sizeof(*ctx->cache));
+	ctx->cache = NULL;
+}
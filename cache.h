@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "poemgr.h"
+
+#define POEMGR_CONFIG_FILE		"/etc/config/poemgr"
+#define POEMGR_CONFIG_DELTA_FILE	"/tmp/.uci/poemgr"
+#define POEMGR_CACHE_FILE		"/var/run/poemgr.cache"
+
+#define POEMGR_CACHE_MAGIC		0x43454f50	/* "POEC" */
+#define POEMGR_CACHE_VERSION		1
+
+#define POEMGR_CACHE_STR_LEN		64
+
+/* Identity of a file the cache was derived from */
+struct poemgr_cache_file_id {
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+};
+
+struct poemgr_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+
+	/* Layout of the settings structures copied into the cache */
+	uint32_t settings_size;
+	uint32_t port_settings_size;
+	uint32_t max_ports;
+
+	struct poemgr_cache_file_id config;
+	struct poemgr_cache_file_id exe;
+};
+
+/**
+ * Binary image of the parsed configuration. The settings structures are
+ * stored as-is, string pointers are replaced by the fixed size buffers
+ * below when the cache is loaded.
+ */
+struct poemgr_cache {
+	struct poemgr_cache_header hdr;
+
+	struct poemgr_settings settings;
+	char profile[POEMGR_CACHE_STR_LEN];
+
+	struct poemgr_port_settings port_settings[POEMGR_MAX_PORTS];
+	char port_names[POEMGR_MAX_PORTS][POEMGR_CACHE_STR_LEN];
+};
+
+/* Files used by the cache, POEMGR_*_FILE unless changed by a test */
+extern const char *poemgr_cache_config_file;
+extern const char *poemgr_cache_config_delta_file;
+extern const char *poemgr_cache_file;
+
+/**
+ * Load the settings from the cache. Returns 0 on success, or non-zero when
+ * the cache is missing or stale.
+ *
+ * config is set to the identity of the configuration file at the time of the
+ * check. It is passed to poemgr_cache_store() after parsing the configuration
+ * with libuci, so a change while parsing invalidates the new cache. It is
+ * left zeroed if the configuration must not be cached.
+ */
+int poemgr_cache_load(struct poemgr_ctx *ctx, struct poemgr_cache_file_id *config);
+
+int poemgr_cache_store(struct poemgr_ctx *ctx, const struct poemgr_cache_file_id *config);
+
+void poemgr_cache_release(struct poemgr_ctx *ctx);
@@ -0,0 +1,224 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "capture.h"
+
+/**
+ * SMBus transfers of the PSE chips can be recorded to a binary file, and
+ * replayed instead of accessing the bus. Replay feeds the recorded transfers
+ * back in order, reproducing their results and latency. Transfers not
+ * matching the recording end the replay.
+ */
+
+struct poemgr_capture poemgr_capture;
+
+static int64_t poemgr_capture_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Bytes of transfer data for a transfer type */
+static int poemgr_capture_data_len(int size, const union i2c_smbus_data *data)
+{
+	switch (size) {
+		case I2C_SMBUS_BYTE_DATA:
+			return 1;
+		case I2C_SMBUS_I2C_BLOCK_DATA:
+			if (data->block[0] > I2C_SMBUS_BLOCK_MAX)
+				return -1;
+			return data->block[0] + 1;
+		default:
+			return -1;
+	}
+}
+
+int poemgr_capture_record_open(const char *path)
+{
+	struct poemgr_capture_header hdr = {};
+
+	poemgr_capture.file = fopen(path, "wb");
+	if (!poemgr_capture.file) {
+		perror(path);
+		return 1;
+	}
+
+	hdr.magic = POEMGR_CAPTURE_MAGIC;
+	hdr.version = POEMGR_CAPTURE_VERSION;
+	hdr.start_sec = time(NULL);
+
+	if (fwrite(&hdr, sizeof(hdr), 1, poemgr_capture.file) != 1) {
+		fclose(poemgr_capture.file);
+		poemgr_capture.file = NULL;
+		return 1;
+	}
+
+	poemgr_capture.start_us = poemgr_capture_now();
+	poemgr_capture.mode = POEMGR_CAPTURE_RECORD;
+
+	return 0;
+}
+
+void poemgr_capture_record(uint8_t addr, char read_write, uint8_t reg, int size,
+			   const union i2c_smbus_data *data, int64_t start_us, int64_t latency_us, int err)
+{
+	struct poemgr_capture_record rec = {};
+	int len;
+
+	len = poemgr_capture_data_len(size, data);
+
+	/* Failed reads don't return data */
+	if (len < 0 || (err && read_write == I2C_SMBUS_READ))
+		len = 0;
+
+	rec.time_us = start_us - poemgr_capture.start_us;
+	rec.latency_us = latency_us;
+	rec.err = err;
+	rec.addr = addr;
+	rec.reg = reg;
+	rec.read_write = read_write;
+	rec.size = size;
+	rec.len = len;
+
+	if (fwrite(&rec, sizeof(rec), 1, poemgr_capture.file) != 1 ||
+	    fwrite(data, 1, len, poemgr_capture.file) != (size_t) len) {
+		fprintf(stderr, "Error writing capture, recording stopped\n");
+		fclose(poemgr_capture.file);
+		poemgr_capture.file = NULL;
+		poemgr_capture.mode = POEMGR_CAPTURE_OFF;
+	}
+}
+
+int poemgr_capture_replay_open(const char *path, double speed)
+{
+	const struct poemgr_capture_header *hdr;
+	uint8_t *buf = NULL;
+	size_t len = 0;
+	size_t n;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return 1;
+	}
+
+	/* Captures are replayed from memory to not add file I/O to the transfers */
+	do {
+		uint8_t *tmp = realloc(buf, len + 65536);
+
+		if (!tmp) {
+			free(buf);
+			fclose(f);
+			return 1;
+		}
+
+		buf = tmp;
+		n = fread(buf + len, 1, 65536, f);
+		len += n;
+	} while (n > 0);
+
+	fclose(f);
+
+	hdr = (const struct poemgr_capture_header *) buf;
+	if (len < sizeof(*hdr) || hdr->magic != POEMGR_CAPTURE_MAGIC ||
+	    hdr->version != POEMGR_CAPTURE_VERSION) {
+		fprintf(stderr, "%s: Not a capture file\n", path);
+		free(buf);
+		return 1;
+	}
+
+	poemgr_capture.buf = buf;
+	poemgr_capture.buf_len = len;
+	poemgr_capture.offset = sizeof(*hdr);
+	poemgr_capture.num_records = 0;
+	poemgr_capture.speed = speed;
+	poemgr_capture.diverged = 0;
+	poemgr_capture.mode = POEMGR_CAPTURE_REPLAY;
+
+	return 0;
+}
+
+static void poemgr_capture_diverged(const char *reason)
+{
+	if (!poemgr_capture.diverged)
+		fprintf(stderr, "Replay stopped at transfer %u: %s\n", poemgr_capture.num_records, reason);
+
+	poemgr_capture.diverged = 1;
+}
+
+int poemgr_capture_replay(uint8_t addr, char read_write, uint8_t reg, int size, union i2c_smbus_data *data)
+{
+	struct poemgr_capture_record rec;
+	int len;
+
+	/* Behave like a missing device, so callers don't retry */
+	if (poemgr_capture.diverged) {
+		errno = EBADF;
+		return -1;
+	}
+
+	if (poemgr_capture.buf_len - poemgr_capture.offset < sizeof(rec)) {
+		poemgr_capture_diverged("end of capture");
+		errno = EBADF;
+		return -1;
+	}
+
+	memcpy(&rec, poemgr_capture.buf + poemgr_capture.offset, sizeof(rec));
+
+	if (rec.len > POEMGR_CAPTURE_MAX_DATA ||
+	    poemgr_capture.buf_len - poemgr_capture.offset - sizeof(rec) < rec.len) {
+		poemgr_capture_diverged("truncated capture");
+		errno = EBADF;
+		return -1;
+	}
+
+	if (rec.addr != addr || rec.reg != reg || rec.read_write != (uint8_t) read_write || rec.size != size) {
+		poemgr_capture_diverged("transfer does not match capture");
+		errno = EBADF;
+		return -1;
+	}
+
+	len = poemgr_capture_data_len(size, data);
+	if (read_write == I2C_SMBUS_WRITE && len >= 0 && len == rec.len &&
+	    memcmp(data, poemgr_capture.buf + poemgr_capture.offset + sizeof(rec), len))
+		fprintf(stderr, "Replay transfer %u: written data differs from capture\n",
+			poemgr_capture.num_records);
+
+	if (read_write == I2C_SMBUS_READ && !rec.err)
+		memcpy(data, poemgr_capture.buf + poemgr_capture.offset + sizeof(rec), rec.len);
+
+	poemgr_capture.offset += sizeof(rec) + rec.len;
+	poemgr_capture.num_records++;
+
+	if (poemgr_capture.speed > 0)
+		usleep(rec.latency_us / poemgr_capture.speed);
+
+	if (rec.err) {
+		errno = rec.err;
+		return -1;
+	}
+
+	return 0;
+}
+
+int poemgr_capture_close(void)
+{
+	int ret = 0;
+
+	if (poemgr_capture.file)
+		ret = !!fclose(poemgr_capture.file);
+
+	free(poemgr_capture.buf);
+	memset(&poemgr_capture, 0, sizeof(poemgr_capture));
+
+	return ret;
+}
@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <linux/i2c.h>
+
+#define POEMGR_CAPTURE_MAGIC		0x49454f50	/* "POEI" */
+#define POEMGR_CAPTURE_VERSION		1
+
+/* Block transfers carry the length byte in front of the data */
+#define POEMGR_CAPTURE_MAX_DATA		(I2C_SMBUS_BLOCK_MAX + 1)
+
+enum poemgr_capture_mode {
+	POEMGR_CAPTURE_OFF,
+	POEMGR_CAPTURE_RECORD,
+	POEMGR_CAPTURE_REPLAY,
+};
+
+struct poemgr_capture_header {
+	uint32_t magic;
+	uint32_t version;
+
+	/* Wall clock time the capture was started at */
+	int64_t start_sec;
+};
+
+/* One SMBus transfer, followed by len bytes of transfer data */
+struct poemgr_capture_record {
+	uint64_t time_us;	/* Since start of the capture */
+	uint32_t latency_us;
+	int16_t err;		/* errno of the transfer, 0 on success */
+	uint8_t addr;
+	uint8_t reg;
+	uint8_t read_write;
+	uint8_t size;		/* SMBus transfer type */
+	uint8_t len;
+	uint8_t reserved[5];
+};
+
+struct poemgr_capture {
+	enum poemgr_capture_mode mode;
+
+	/* Record */
+	FILE *file;
+	int64_t start_us;
+
+	/* Replay */
+	uint8_t *buf;
+	size_t buf_len;
+	size_t offset;
+	uint32_t num_records;
+	double speed;
+	int diverged;
+};
+
+extern struct poemgr_capture poemgr_capture;
+
+int poemgr_capture_record_open(const char *path);
+
+/* speed scales the recorded transfer latency, 0 replays without delay */
+int poemgr_capture_replay_open(const char *path, double speed);
+
+int poemgr_capture_close(void);
+
+static inline int poemgr_capture_recording(void)
+{
+	return poemgr_capture.mode == POEMGR_CAPTURE_RECORD;
+}
+
+static inline int poemgr_capture_replaying(void)
+{
+	return poemgr_capture.mode == POEMGR_CAPTURE_REPLAY;
+}
+
+void poemgr_capture_record(uint8_t addr, char read_write, uint8_t reg, int size,
+			   const union i2c_smbus_data *data, int64_t start_us, int64_t latency_us, int err);
+
+/* Returns the result of the next recorded transfer, sets errno on failure */
+int poemgr_capture_replay(uint8_t addr, char read_write, uint8_t reg, int size, union i2c_smbus_data *data);
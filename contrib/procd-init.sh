@@ -8,6 +8,7 @@ PROG=/sbin/poemgr
 
 reload_service() {
 	start
+	procd_send_signal poemgr
 }
 
 service_triggers() {
@@ -29,5 +30,10 @@ start_service()
 		$PROG disable
 	else
 		$PROG apply
+
+		procd_open_instance
+		procd_set_param command $PROG daemon
+		procd_set_param respawn
+		procd_close_instance
 	fi
 }
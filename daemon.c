@@ -0,0 +1,217 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <json.h>
+
+#include "bringup.h"
+#include "daemon.h"
+#include "hotplug.h"
+#include "journal.h"
+#include "scheduler.h"
+#include "snmp.h"
+#include "thermal.h"
+#include "trace.h"
+#include "ubus.h"
+
+static volatile sig_atomic_t poemgr_daemon_stop;
+static volatile sig_atomic_t poemgr_daemon_reload;
+
+static void poemgr_daemon_signal(int signo)
+{
+	if (signo == SIGHUP)
+		poemgr_daemon_reload = 1;
+	else
+		poemgr_daemon_stop = 1;
+}
+
+static int poemgr_daemon_write_status(struct poemgr_ctx *ctx)
+{
+	struct json_object *root_obj;
+	int ret = 0;
+
+	root_obj = poemgr_status_to_json(ctx);
+
+	/* Replace atomically, readers never see a partially written file */
+	if (json_object_to_file_ext(POEMGR_STATUS_FILE ".tmp", root_obj, JSON_C_TO_STRING_PLAIN) ||
+	    rename(POEMGR_STATUS_FILE ".tmp", POEMGR_STATUS_FILE)) {
+		fprintf(stderr, "Error writing %s\n", POEMGR_STATUS_FILE);
+		ret = 1;
+	}
+
+	json_object_put(root_obj);
+	return ret;
+}
+
+static void poemgr_daemon_wait(int64_t until)
+{
+	struct pollfd fds[2];
+	struct timespec ts;
+	int64_t timeout;
+
+	timeout = until - poemgr_time_ms();
+	if (timeout < 0)
+		timeout = 0;
+
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000000;
+
+	/* Sockets which are not connected (-1) are ignored by poll */
+	fds[0].fd = poemgr_ubus_fd();
+	fds[1].fd = poemgr_snmp_fd();
+	for (int i = 0; i < 2; i++) {
+		fds[i].events = POLLIN;
+		fds[i].revents = 0;
+	}
+
+	/* Interrupted by signals, SIGCHLD of event handlers is only delivered here */
+	if (ppoll(fds, 2, &ts, poemgr_hotplug_wait_mask()) <= 0)
+		return;
+
+	if (fds[0].revents)
+		poemgr_ubus_handle();
+
+	if (fds[1].revents)
+		poemgr_snmp_handle();
+}
+
+static void poemgr_daemon_dispatch(struct poemgr_ctx *ctx, struct poemgr_sched_result *result)
+{
+	for (int i = 0; i < poemgr_profile_num_ports(ctx); i++) {
+		if (!(result->changed_ports & (1 << i)))
+			continue;
+
+		poemgr_journal_port(ctx, i, &result->old_port_status[i]);
+		poemgr_hotplug_port(ctx, i, &result->old_port_status[i]);
+		poemgr_ubus_notify_port(ctx, i, &result->old_port_status[i]);
+		poemgr_snmp_notify_port(ctx, i, &result->old_port_status[i]);
+	}
+
+	if (result->pse_changed) {
+		poemgr_journal_input(ctx, &result->old_input_status);
+		poemgr_hotplug_input(ctx, &result->old_input_status);
+		poemgr_ubus_notify_input(ctx, &result->old_input_status);
+	}
+
+	poemgr_daemon_write_status(ctx);
+}
+
+/* Apply the derated port configuration of the current thermal level. Shed ports return one after the
+ * other, brought up from the daemon loop.
+ */
+static void poemgr_daemon_thermal_apply(struct poemgr_ctx *ctx)
+{
+	int64_t span;
+	int ret;
+
+	span = poemgr_trace_begin();
+	ret = poemgr_apply_config(ctx);
+	poemgr_trace_end(span, "poemgr", "thermal apply", 2, "level", ctx->thermal.level, "result", ret);
+}
+
+void poemgr_daemon_refresh(struct poemgr_ctx *ctx)
+{
+	poemgr_sched_init(ctx, poemgr_time_ms());
+}
+
+int poemgr_daemon(struct poemgr_ctx *ctx, const char *ubus_path, const char *agentx_path)
+{
+	struct poemgr_sched_result result;
+	struct sigaction sa = {
+		.sa_handler = &poemgr_daemon_signal,
+	};
+	int64_t next_update, hotplug_update, bringup_update;
+	int64_t now;
+	int ready = 0;
+	int ret = 0;
+
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGHUP, &sa, NULL);
+
+	if (poemgr_ubus_init(ctx, ubus_path))
+		return 1;
+
+	if (poemgr_snmp_init(ctx, agentx_path)) {
+		poemgr_ubus_done();
+		return 1;
+	}
+
+	/* Not fatal, the daemon keeps publishing the current state */
+	poemgr_journal_open(POEMGR_JOURNAL_FILE);
+	poemgr_hotplug_init();
+
+	poemgr_sched_init(ctx, poemgr_time_ms());
+
+	while (!poemgr_daemon_stop) {
+		if (poemgr_daemon_reload) {
+			poemgr_daemon_reload = 0;
+
+			/* Context is unusable after a failed reload, let procd restart us */
+			ret = poemgr_reload(ctx);
+			if (ret) {
+				fprintf(stderr, "Error reloading configuration\n");
+				break;
+			}
+
+			poemgr_daemon_refresh(ctx);
+
+			/* A concurrent apply restored the full configuration */
+			if (ctx->thermal.level != POEMGR_THERMAL_LEVEL_NORMAL)
+				poemgr_daemon_thermal_apply(ctx);
+		}
+
+		now = poemgr_time_ms();
+		next_update = poemgr_sched_next_update(ctx);
+
+		/* Start queued event handlers and switch on the next port before waiting */
+		hotplug_update = poemgr_hotplug_run(now);
+		bringup_update = poemgr_bringup_run(ctx, now);
+
+		/* Woken up by a request or a finished handler, nothing to refresh yet */
+		if (next_update > now) {
+			if (hotplug_update < next_update)
+				next_update = hotplug_update;
+			if (bringup_update < next_update)
+				next_update = bringup_update;
+
+			poemgr_daemon_wait(next_update);
+			continue;
+		}
+
+		if (!poemgr_profile_cb(ctx, ready)(ctx)) {
+			/* PSE powered down, check again on the PSE cadence */
+			ready = 0;
+			poemgr_sched_init(ctx, now + ctx->pse_poll.interval);
+			continue;
+		} else if (!ready) {
+			/* PSE (re-)appeared, refresh everything */
+			ready = 1;
+			poemgr_sched_init(ctx, now);
+		}
+
+		poemgr_sched_run(ctx, now, &result);
+
+		if (result.pse_updated && poemgr_thermal_update(ctx)) {
+			poemgr_daemon_thermal_apply(ctx);
+			result.pse_changed = 1;
+		}
+
+		if (result.changed_ports || result.pse_changed)
+			poemgr_daemon_dispatch(ctx, &result);
+	}
+
+	/* Don't leave ports held off when stopping */
+	poemgr_bringup_abort(ctx);
+
+	poemgr_hotplug_done();
+	poemgr_journal_close();
+	poemgr_snmp_done();
+	poemgr_ubus_done();
+
+	return ret;
+}
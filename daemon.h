@@ -0,0 +1,13 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include "poemgr.h"
+
+#define POEMGR_STATUS_FILE		"/var/run/poemgr.json"
+
+/* ubus_path, agentx_path: Sockets to connect to, NULL for the defaults */
+int poemgr_daemon(struct poemgr_ctx *ctx, const char *ubus_path, const char *agentx_path);
+
+/* Refresh all status items on the next loop iteration, e.g. after applying the configuration */
+void poemgr_daemon_refresh(struct poemgr_ctx *ctx);
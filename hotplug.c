@@ -0,0 +1,281 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "hotplug.h"
+
+/**
+ * Port events are handed to the scripts in /etc/hotplug.d/poe through
+ * hotplug-call. Handlers run in child processes, so slow scripts never delay
+ * polling the PSE. Starts are limited by a token bucket and the number of
+ * running handlers, events queue up in between.
+ */
+
+/* Milliseconds of credit one handler start costs */
+#define POEMGR_HOTPLUG_START_COST	(1000 / POEMGR_HOTPLUG_RATE)
+
+struct poemgr_hotplug {
+	int enabled;
+
+	struct poemgr_hotplug_event queue[POEMGR_HOTPLUG_QUEUE_LEN];
+	int head;
+	int count;
+	int dropped;
+
+	int running;
+
+	/* Token bucket (milliseconds) */
+	int64_t credit;
+	int64_t last_refill;
+};
+
+static struct poemgr_hotplug poemgr_hotplug;
+
+/* Signal mask while the daemon waits, SIGCHLD is blocked everywhere else */
+static sigset_t poemgr_hotplug_mask;
+
+static void poemgr_hotplug_sigchld(int signo)
+{
+	/* Only interrupts the daemon's wait, children are reaped by poemgr_hotplug_run */
+}
+
+void poemgr_hotplug_init(void)
+{
+	struct sigaction sa = {
+		.sa_handler = &poemgr_hotplug_sigchld,
+		.sa_flags = SA_NOCLDSTOP,
+	};
+	sigset_t mask;
+
+	memset(&poemgr_hotplug, 0, sizeof(poemgr_hotplug));
+
+	if (access(POEMGR_HOTPLUG_CALL, X_OK))
+		return;
+
+	/*
+	 * A finished handler must not cut short a sleep or a blocking call
+	 * (SMBus backoff, AgentX responses). SIGCHLD is only delivered while
+	 * the daemon waits in poemgr_daemon_wait.
+	 */
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &mask, &poemgr_hotplug_mask);
+	sigdelset(&poemgr_hotplug_mask, SIGCHLD);
+
+	sigaction(SIGCHLD, &sa, NULL);
+
+	poemgr_hotplug.enabled = 1;
+	poemgr_hotplug.credit = POEMGR_HOTPLUG_BURST * POEMGR_HOTPLUG_START_COST;
+	poemgr_hotplug.last_refill = -1;
+}
+
+void poemgr_hotplug_done(void)
+{
+	struct sigaction sa = {
+		.sa_handler = SIG_DFL,
+	};
+
+	if (!poemgr_hotplug.enabled)
+		return;
+
+	/* Running handlers are left to finish on their own */
+	sigaction(SIGCHLD, &sa, NULL);
+	sigprocmask(SIG_SETMASK, &poemgr_hotplug_mask, NULL);
+	poemgr_hotplug.enabled = 0;
+}
+
+const sigset_t *poemgr_hotplug_wait_mask(void)
+{
+	if (!poemgr_hotplug.enabled)
+		return NULL;
+
+	return &poemgr_hotplug_mask;
+}
+
+static struct poemgr_hotplug_event *poemgr_hotplug_queue(const char *action)
+{
+	struct poemgr_hotplug_event *event;
+
+	if (!poemgr_hotplug.enabled)
+		return NULL;
+
+	if (poemgr_hotplug.count == POEMGR_HOTPLUG_QUEUE_LEN) {
+		/* Report once per overflow */
+		if (!poemgr_hotplug.dropped++)
+			fprintf(stderr, "Hotplug queue full, dropping events\n");
+		return NULL;
+	}
+
+	event = &poemgr_hotplug.queue[(poemgr_hotplug.head + poemgr_hotplug.count) % POEMGR_HOTPLUG_QUEUE_LEN];
+	poemgr_hotplug.count++;
+
+	memset(event, 0, sizeof(*event));
+	event->action = action;
+	event->port = -1;
+
+	return event;
+}
+
+void poemgr_hotplug_port(struct poemgr_ctx *ctx, int port, struct poemgr_port_status *old_status)
+{
+	struct poemgr_port *p = &ctx->ports[port];
+	struct poemgr_hotplug_event *event;
+	const char *action;
+
+	if (!old_status->active && p->status.active)
+		action = "up";
+	else if (old_status->active && !p->status.active)
+		action = "down";
+	else if (old_status->poe_class != p->status.poe_class)
+		action = "class";
+	else if (p->status.faults & ~old_status->faults)
+		action = "fault";
+	else if (old_status->faults & ~p->status.faults)
+		action = "clear";
+	else
+		return;
+
+	event = poemgr_hotplug_queue(action);
+	if (!event)
+		return;
+
+	/* Settings do not outlive a reload, keep a copy */
+	event->port = port;
+	if (p->settings.name)
+		snprintf(event->name, sizeof(event->name), "%s", p->settings.name);
+	event->poe_class = p->status.poe_class;
+	event->power = p->status.power;
+	event->faults = p->status.faults;
+	event->input_type = ctx->input_status.type;
+}
+
+void poemgr_hotplug_input(struct poemgr_ctx *ctx, struct poemgr_input_status *old_status)
+{
+	struct poemgr_hotplug_event *event;
+
+	if (old_status->type == ctx->input_status.type)
+		return;
+
+	event = poemgr_hotplug_queue("input");
+	if (!event)
+		return;
+
+	event->input_type = ctx->input_status.type;
+}
+
+static void poemgr_hotplug_setenv_int(const char *name, int val)
+{
+	char buf[12];
+
+	snprintf(buf, sizeof(buf), "%d", val);
+	setenv(name, buf, 1);
+}
+
+/* Runs in the child */
+static void poemgr_hotplug_exec(struct poemgr_hotplug_event *event)
+{
+	char faults[256] = "";
+	size_t len = 0;
+	sigset_t mask;
+	int fault;
+
+	sigemptyset(&mask);
+	sigprocmask(SIG_SETMASK, &mask, NULL);
+
+	setenv("ACTION", event->action, 1);
+	setenv("INPUT", poemgr_poe_type_to_string(event->input_type), 1);
+
+	if (event->port >= 0) {
+		poemgr_for_each_port_fault(fault) {
+			if (!(event->faults & fault) || len >= sizeof(faults))
+				continue;
+
+			len += snprintf(faults + len, sizeof(faults) - len, "%s%s", len ? " " : "",
+					poemgr_port_fault_to_string(fault));
+		}
+
+		poemgr_hotplug_setenv_int("PORT", event->port);
+		if (event->name[0])
+			setenv("NAME", event->name, 1);
+		poemgr_hotplug_setenv_int("CLASS", event->poe_class);
+		poemgr_hotplug_setenv_int("POWER", event->power);
+		setenv("FAULTS", faults, 1);
+	}
+
+	execl(POEMGR_HOTPLUG_CALL, POEMGR_HOTPLUG_CALL, POEMGR_HOTPLUG_SUBSYSTEM, (char *) NULL);
+	_exit(127);
+}
+
+static int poemgr_hotplug_start(struct poemgr_hotplug_event *event)
+{
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+
+	if (pid == 0)
+		poemgr_hotplug_exec(event);
+
+	poemgr_hotplug.running++;
+	return 0;
+}
+
+int64_t poemgr_hotplug_run(int64_t now)
+{
+	struct poemgr_hotplug *hp = &poemgr_hotplug;
+	int64_t max_credit = POEMGR_HOTPLUG_BURST * POEMGR_HOTPLUG_START_COST;
+	int64_t next = INT64_MAX, retry;
+
+	if (!hp->enabled)
+		return INT64_MAX;
+
+	while (hp->running && waitpid(-1, NULL, WNOHANG) > 0)
+		hp->running--;
+
+	if (hp->last_refill >= 0)
+		hp->credit += now - hp->last_refill;
+	if (hp->credit > max_credit)
+		hp->credit = max_credit;
+	hp->last_refill = now;
+
+	while (hp->count && hp->running < POEMGR_HOTPLUG_MAX_RUNNING &&
+	       hp->credit >= POEMGR_HOTPLUG_START_COST) {
+		/* Retried on the next call */
+		if (poemgr_hotplug_start(&hp->queue[hp->head]))
+			break;
+
+		hp->credit -= POEMGR_HOTPLUG_START_COST;
+		hp->head = (hp->head + 1) % POEMGR_HOTPLUG_QUEUE_LEN;
+		hp->count--;
+	}
+
+	if (hp->dropped && hp->count < POEMGR_HOTPLUG_QUEUE_LEN) {
+		fprintf(stderr, "Hotplug queue overflow, %d events dropped\n", hp->dropped);
+		hp->dropped = 0;
+	}
+
+	/* Woken up by SIGCHLD, reaping again in case of a lost wakeup */
+	if (hp->running)
+		next = now + POEMGR_HOTPLUG_REAP_INTERVAL;
+
+	/* Out of credit, or retrying a failed start */
+	if (hp->count && hp->running < POEMGR_HOTPLUG_MAX_RUNNING) {
+		if (hp->credit < POEMGR_HOTPLUG_START_COST)
+			retry = now + POEMGR_HOTPLUG_START_COST - hp->credit;
+		else
+			retry = now + POEMGR_HOTPLUG_START_COST;
+
+		if (retry < next)
+			next = retry;
+	}
+
+	return next;
+}
@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include <signal.h>
+#include <stdint.h>
+
+#include "poemgr.h"
+
+#define POEMGR_HOTPLUG_CALL		"/sbin/hotplug-call"
+#define POEMGR_HOTPLUG_SUBSYSTEM	"poe"
+
+/* Events waiting for a handler, further events are dropped */
+#define POEMGR_HOTPLUG_QUEUE_LEN	32
+
+/* Handlers running at the same time */
+#define POEMGR_HOTPLUG_MAX_RUNNING	2
+
+/* Handler starts per second, and the number of starts allowed at once */
+#define POEMGR_HOTPLUG_RATE		5
+#define POEMGR_HOTPLUG_BURST		10
+
+/* Check for finished handlers while a SIGCHLD may have been missed (milliseconds) */
+#define POEMGR_HOTPLUG_REAP_INTERVAL	1000
+
+#define POEMGR_HOTPLUG_NAME_LEN		64
+
+struct poemgr_hotplug_event {
+	const char *action;
+
+	/* -1 for input events */
+	int port;
+	char name[POEMGR_HOTPLUG_NAME_LEN];
+	int poe_class;
+	int power;
+	int faults;
+
+	enum poemgr_poe_type input_type;
+};
+
+/* Handlers are not run when hotplug-call is missing */
+void poemgr_hotplug_init(void);
+
+void poemgr_hotplug_done(void);
+
+/* Signal mask to wait with, SIGCHLD is blocked outside of it. NULL keeps the current mask */
+const sigset_t *poemgr_hotplug_wait_mask(void);
+
+/* Queue an event if the port was switched, changed its class or its faults */
+void poemgr_hotplug_port(struct poemgr_ctx *ctx, int port, struct poemgr_port_status *old_status);
+
+/* Queue an event if the input type changed */
+void poemgr_hotplug_input(struct poemgr_ctx *ctx, struct poemgr_input_status *old_status);
+
+/* Reap finished handlers and start queued events. Returns when to call again, INT64_MAX if idle */
+int64_t poemgr_hotplug_run(int64_t now);
@@ -0,0 +1,207 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "journal.h"
+
+/**
+ * The daemon appends port transitions and faults to a ring of fixed-size
+ * records on tmpfs. Every record is written before the header advances, so
+ * readers only ever see complete records. Records overwritten while being
+ * read are detected by their sequence number.
+ */
+
+static int poemgr_journal_fd = -1;
+static struct poemgr_journal_header poemgr_journal_hdr;
+
+static void poemgr_journal_init_header(struct poemgr_journal_header *hdr)
+{
+	hdr->magic = POEMGR_JOURNAL_MAGIC;
+	hdr->version = POEMGR_JOURNAL_VERSION;
+	hdr->record_size = sizeof(struct poemgr_journal_record);
+	hdr->max_records = POEMGR_JOURNAL_MAX_RECORDS;
+	hdr->next = 0;
+}
+
+static int poemgr_journal_header_valid(const struct poemgr_journal_header *hdr)
+{
+	return hdr->magic == POEMGR_JOURNAL_MAGIC &&
+	       hdr->version == POEMGR_JOURNAL_VERSION &&
+	       hdr->record_size == sizeof(struct poemgr_journal_record) &&
+	       hdr->max_records == POEMGR_JOURNAL_MAX_RECORDS;
+}
+
+static off_t poemgr_journal_offset(uint64_t idx)
+{
+	return sizeof(struct poemgr_journal_header) +
+	       (off_t) (idx % POEMGR_JOURNAL_MAX_RECORDS) * sizeof(struct poemgr_journal_record);
+}
+
+int poemgr_journal_open(const char *path)
+{
+	struct poemgr_journal_header *hdr = &poemgr_journal_hdr;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+
+	/* Continue a journal of a previous daemon, start over on a format change */
+	if (pread(fd, hdr, sizeof(*hdr), 0) != sizeof(*hdr) || !poemgr_journal_header_valid(hdr)) {
+		poemgr_journal_init_header(hdr);
+
+		if (ftruncate(fd, 0) || pwrite(fd, hdr, sizeof(*hdr), 0) != sizeof(*hdr)) {
+			perror(path);
+			close(fd);
+			return 1;
+		}
+	}
+
+	poemgr_journal_fd = fd;
+	return 0;
+}
+
+void poemgr_journal_close(void)
+{
+	if (poemgr_journal_fd < 0)
+		return;
+
+	close(poemgr_journal_fd);
+	poemgr_journal_fd = -1;
+}
+
+static void poemgr_journal_append(struct poemgr_journal_record *rec)
+{
+	struct poemgr_journal_header *hdr = &poemgr_journal_hdr;
+	struct timespec ts;
+
+	if (poemgr_journal_fd < 0)
+		return;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	rec->time_ms = (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	rec->seq = hdr->next;
+
+	if (pwrite(poemgr_journal_fd, rec, sizeof(*rec), poemgr_journal_offset(hdr->next)) != sizeof(*rec))
+		goto err;
+
+	hdr->next++;
+	if (pwrite(poemgr_journal_fd, &hdr->next, sizeof(hdr->next),
+		   offsetof(struct poemgr_journal_header, next)) != sizeof(hdr->next))
+		goto err;
+
+	return;
+
+err:
+	/* Don't keep failing on every transition, e.g. with tmpfs full */
+	fprintf(stderr, "Error writing journal, disabling it\n");
+	poemgr_journal_close();
+}
+
+void poemgr_journal_port(struct poemgr_ctx *ctx, int port, struct poemgr_port_status *old_status)
+{
+	struct poemgr_port_status *status = &ctx->ports[port].status;
+	struct poemgr_journal_record rec = {};
+
+	/* Power readings change on every poll, only keep events */
+	if (!!status->active == !!old_status->active && status->faults == old_status->faults)
+		return;
+
+	rec.port = port;
+	rec.old_active = !!old_status->active;
+	rec.active = !!status->active;
+	rec.poe_class = status->poe_class;
+	rec.faults = status->faults;
+	rec.input_type = ctx->input_status.type;
+
+	poemgr_journal_append(&rec);
+}
+
+void poemgr_journal_input(struct poemgr_ctx *ctx, struct poemgr_input_status *old_status)
+{
+	struct poemgr_journal_record rec = {};
+
+	if (ctx->input_status.type == old_status->type)
+		return;
+
+	rec.port = POEMGR_JOURNAL_PORT_NONE;
+	rec.poe_class = -1;
+	rec.input_type = ctx->input_status.type;
+
+	poemgr_journal_append(&rec);
+}
+
+int poemgr_journal_read(const char *path, struct poemgr_journal_record **records, size_t *num_records)
+{
+	struct poemgr_journal_record *buf, *out;
+	struct poemgr_journal_header hdr;
+	uint64_t first;
+	size_t n = 0;
+	ssize_t len;
+	int fd;
+
+	*records = NULL;
+	*num_records = 0;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		/* Daemon did not record anything yet */
+		if (errno == ENOENT)
+			return 0;
+
+		perror(path);
+		return 1;
+	}
+
+	if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || !poemgr_journal_header_valid(&hdr)) {
+		fprintf(stderr, "Invalid journal %s\n", path);
+		close(fd);
+		return 1;
+	}
+
+	buf = calloc(POEMGR_JOURNAL_MAX_RECORDS, sizeof(*buf));
+	out = calloc(POEMGR_JOURNAL_MAX_RECORDS, sizeof(*out));
+	if (!buf || !out) {
+		free(buf);
+		free(out);
+		close(fd);
+		return 1;
+	}
+
+	len = pread(fd, buf, POEMGR_JOURNAL_MAX_RECORDS * sizeof(*buf), sizeof(hdr));
+	close(fd);
+	if (len < 0) {
+		perror(path);
+		free(buf);
+		free(out);
+		return 1;
+	}
+
+	/* Unroll the ring, oldest record first */
+	first = hdr.next > POEMGR_JOURNAL_MAX_RECORDS ? hdr.next - POEMGR_JOURNAL_MAX_RECORDS : 0;
+	for (uint64_t i = first; i < hdr.next; i++) {
+		struct poemgr_journal_record *rec = &buf[i % POEMGR_JOURNAL_MAX_RECORDS];
+
+		/* Overwritten by the daemon after reading the header */
+		if (rec->seq != (uint32_t) i)
+			continue;
+
+		out[n++] = *rec;
+	}
+
+	free(buf);
+
+	*records = out;
+	*num_records = n;
+
+	return 0;
+}
@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "poemgr.h"
+
+#define POEMGR_JOURNAL_FILE		"/var/run/poemgr.journal"
+
+#define POEMGR_JOURNAL_MAGIC		0x4a454f50	/* "POEJ" */
+#define POEMGR_JOURNAL_VERSION		1
+
+/* Records kept before the oldest one is overwritten */
+#define POEMGR_JOURNAL_MAX_RECORDS	2048
+
+/* Record port of events not related to a port */
+#define POEMGR_JOURNAL_PORT_NONE	0xff
+
+struct poemgr_journal_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t max_records;
+
+	/* Number of records ever written, the next record goes to slot next % max_records */
+	uint64_t next;
+};
+
+/* Port state transition, fault change or input change */
+struct poemgr_journal_record {
+	int64_t time_ms;	/* Wall clock */
+	uint32_t seq;		/* Lower bits of the record number */
+	uint16_t faults;
+	uint8_t port;
+	uint8_t old_active;
+	uint8_t active;
+	int8_t poe_class;
+	uint8_t input_type;
+	uint8_t reserved[5];
+};
+
+int poemgr_journal_open(const char *path);
+
+void poemgr_journal_close(void);
+
+/* Record the port if its active state or faults differ from old_status */
+void poemgr_journal_port(struct poemgr_ctx *ctx, int port, struct poemgr_port_status *old_status);
+
+/* Record the input type if it differs from old_status */
+void poemgr_journal_input(struct poemgr_ctx *ctx, struct poemgr_input_status *old_status);
+
+/* Returns the records of the journal oldest first, the caller frees *records */
+int poemgr_journal_read(const char *path, struct poemgr_journal_record **records, size_t *num_records);
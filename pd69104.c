@@ -1,298 +1,557 @@
 /* SPDX-License-Identifier: GPL-2.0-only */
 
 #include <stdio.h>
-#include <stdlib.h>
-#include <fcntl.h>
-#include <unistd.h>
-
-#include <linux/i2c.h>
-#include <linux/i2c-dev.h>
-
-#include <sys/ioctl.h>
+#include <string.h>
 
 #include "pd69104.h"
 #include "pd69104_regs.h"
-
-#define I2C_SMBUS_READ	1
-#define I2C_SMBUS_WRITE	0
+#include "sim.h"
+
+struct pd69104_statp_decode {
+	int8_t poe_class;
+	uint16_t faults;
+};
+
+/* STATP byte -> (PoE class, faults), generated at compile time */
+#define PD69104_STATP_DET(b)	((b) & 0x7)
+#define PD69104_STATP_CLS(b)	(((b) >> 4) & 0x7)
+
+#define PD69104_STATP_DET_FAULTS(d) \
+	((d) == PD69104_REG_STATP_DETECTION_SHORT_CIRCUIT ? POEMGR_FAULT_TYPE_SHORT_CIRCUIT : \
+	 (d) == PD69104_REG_STATP_DETECTION_CPD_TOO_HIGH ? POEMGR_FAULT_TYPE_CAPACITY_TOO_HIGH : \
+	 (d) == PD69104_REG_STATP_DETECTION_RSIG_TOO_LOW ? POEMGR_FAULT_TYPE_RESISTANCE_TOO_LOW : \
+	 (d) == PD69104_REG_STATP_DETECTION_RSIG_TOO_HIGH ? POEMGR_FAULT_TYPE_RESISTANCE_TOO_HIGH : \
+	 (d) == PD69104_REG_STATP_DETECTION_RSIG_OPEN_CIRCUIT ? POEMGR_FAULT_TYPE_OPEN_CIRCUIT : 0)
+
+#define PD69104_STATP_CLS_FAULTS(c) \
+	((c) == PD69104_REG_STATP_CLASSIFICATION_OVER_CURRENT ? POEMGR_FAULT_TYPE_OVER_CURRENT : 0)
+
+#define PD69104_STATP_ENTRY(b) { \
+	.poe_class = PD69104_CLASSIFICATION_TO_CLASS(PD69104_STATP_CLS(b)), \
+	.faults = PD69104_STATP_DET_FAULTS(PD69104_STATP_DET(b)) | PD69104_STATP_CLS_FAULTS(PD69104_STATP_CLS(b)), \
+}
+#define PD69104_STATP_ENTRY4(b)	PD69104_STATP_ENTRY(b), PD69104_STATP_ENTRY((b) + 1), \
+				PD69104_STATP_ENTRY((b) + 2), PD69104_STATP_ENTRY((b) + 3)
+#define PD69104_STATP_ENTRY16(b)	PD69104_STATP_ENTRY4(b), PD69104_STATP_ENTRY4((b) + 4), \
+				PD69104_STATP_ENTRY4((b) + 8), PD69104_STATP_ENTRY4((b) + 12)
+#define PD69104_STATP_ENTRY64(b)	PD69104_STATP_ENTRY16(b), PD69104_STATP_ENTRY16((b) + 16), \
+				PD69104_STATP_ENTRY16((b) + 32), PD69104_STATP_ENTRY16((b) + 48)
+
+static const struct pd69104_statp_decode pd69104_statp_lut[256] = {
+	PD69104_STATP_ENTRY64(0), PD69104_STATP_ENTRY64(64),
+	PD69104_STATP_ENTRY64(128), PD69104_STATP_ENTRY64(192),
+};
 
 static struct pd69104_priv *pd69104_priv(struct poemgr_pse_chip *pse_chip) {
 	return (struct pd69104_priv *) pse_chip->priv;
 }
 
-static int32_t i2c_smbus_access(int file, char read_write, uint8_t command,
-				int size, union i2c_smbus_data *data)
+static int pd69104_rr(struct poemgr_pse_chip *pse_chip, uint8_t reg)
+{
+	return poemgr_smbus_read_byte(&pd69104_priv(pse_chip)->bus, reg);
+}
+
+static int pd69104_field_read(struct poemgr_pse_chip *pse_chip, enum pd69104_field field, int idx)
 {
-	struct i2c_smbus_ioctl_data args;
+	int reg_val = pd69104_rr(pse_chip, pd69104_field_reg(field, idx));
+
+	if (reg_val < 0)
+		return reg_val;
+
+	return pd69104_field_extract(field, idx, reg_val);
+}
 
-	args.read_write = read_write;
-	args.command = command;
-	args.size = size;
-	args.data = data;
-	return ioctl(file,I2C_SMBUS,&args);
+static int pd69104_reg_update(struct poemgr_pse_chip *pse_chip, uint8_t reg, uint8_t mask, uint8_t val)
+{
+	return poemgr_smbus_update(&pd69104_priv(pse_chip)->bus, reg, mask, val);
 }
 
+static int pd69104_field_write(struct poemgr_pse_chip *pse_chip, enum pd69104_field field, int idx, int val)
+{
+	return pd69104_reg_update(pse_chip, pd69104_field_reg(field, idx), pd69104_field_mask(field, idx),
+				  val << pd69104_field_shift(field, idx));
+}
 
-static int pd69104_wr(struct poemgr_pse_chip *pse_chip, uint8_t reg, uint8_t val)
+/* Accessors: pd69104_field_<field>_get(pse_chip, port), pd69104_field_<field>_set(pse_chip, port, val) */
+#define PD69104_FIELD_SETTER_RO(NAME, name)
+#define PD69104_FIELD_SETTER_COR(NAME, name)
+#define PD69104_FIELD_SETTER_RW(NAME, name) \
+static inline int pd69104_field_##name##_set(struct poemgr_pse_chip *pse_chip, int idx, int val) \
+{ \
+	return pd69104_field_write(pse_chip, PD69104_FIELD_##NAME, idx, val); \
+}
+#define PD69104_FIELD_ACCESSORS(NAME, name, reg, per_reg, idx_shift, shift, width, access, snap, decode) \
+static inline int pd69104_field_##name##_get(struct poemgr_pse_chip *pse_chip, int idx) \
+{ \
+	int val = pd69104_field_read(pse_chip, PD69104_FIELD_##NAME, idx); \
+	if (val < 0) \
+		return val; \
+	return pd69104_decode_##decode(val); \
+} \
+PD69104_FIELD_SETTER_##access(NAME, name)
+PD69104_FIELDS(PD69104_FIELD_ACCESSORS)
+#undef PD69104_FIELD_ACCESSORS
+
+static void pd69104_read_plan_build(struct poemgr_smbus_read_plan *plan, uint32_t portmask, int chip)
 {
-	struct pd69104_priv *priv = pd69104_priv(pse_chip);
-	union i2c_smbus_data data;
+	uint8_t needed[PD69104_NUM_REGS] = {};
+	const struct pd69104_field_desc *desc;
+
+	for (int f = 0; f < PD69104_NUM_FIELDS; f++) {
+		desc = &pd69104_fields[f];
+
+		if (desc->snap == PD69104_SNAP_CHIP && chip)
+			needed[pd69104_field_reg(f, 0)] = 1;
 
-	data.byte = val;
+		if (desc->snap == PD69104_SNAP_EVENT && portmask)
+			needed[pd69104_field_reg(f, 0)] = 1;
 
-	return i2c_smbus_access(priv->i2c_fd, I2C_SMBUS_WRITE, reg, 2, &data);
+		if (desc->snap != PD69104_SNAP_PORT)
+			continue;
+
+		for (int port = 0; port < PD69104_NUM_PORTS; port++) {
+			if (portmask & (1 << port))
+				needed[pd69104_field_reg(f, port)] = 1;
+		}
+	}
+
+	poemgr_smbus_plan_build(plan, needed);
 }
 
-static int pd69104_rr(struct poemgr_pse_chip *pse_chip, uint8_t reg)
+static int pd69104_event_faults(const struct poemgr_pse_snapshot *snapshot, int port)
+{
+	int faults = 0;
+
+	if (pd69104_snapshot_fltevn_cor_icut(snapshot, port) ||
+	    pd69104_snapshot_tsevn_cor_tstart(snapshot, port) ||
+	    pd69104_snapshot_tsevn_cor_ilim(snapshot, port))
+		faults |= POEMGR_FAULT_TYPE_OVER_CURRENT;
+
+	/* Thermal shutdown switches off all ports */
+	if (pd69104_snapshot_supevn_cor_tsd(snapshot, 0))
+		faults |= POEMGR_FAULT_TYPE_OVER_TEMPERATURE;
+
+	return faults;
+}
+
+static void pd69104_latch_event_faults(struct pd69104_priv *priv, const struct poemgr_pse_snapshot *snapshot)
+{
+	for (int port = 0; port < PD69104_NUM_PORTS; port++)
+		priv->latched_faults[port] |= pd69104_event_faults(snapshot, port);
+}
+
+int pd69104_snapshot(struct poemgr_pse_chip *pse_chip, struct poemgr_pse_snapshot *snapshot, uint32_t portmask, int chip)
 {
 	struct pd69104_priv *priv = pd69104_priv(pse_chip);
-	union i2c_smbus_data data;
+	int ret;
 
-	if (i2c_smbus_access(priv->i2c_fd, I2C_SMBUS_READ, reg, 2, &data))
-		return -1;
-	
-	return 0x0FF & data.byte;
+	portmask &= (1 << PD69104_NUM_PORTS) - 1;
+
+	snapshot->portmask = 0;
+	snapshot->chip = 0;
+
+	ret = poemgr_smbus_plan_exec(&priv->bus, &priv->port_plans[portmask], snapshot->regs);
+	if (ret)
+		return ret;
+
+	snapshot->portmask = portmask;
+
+	/* The events of the other ports were cleared as well, keep them for their next snapshot */
+	if (portmask)
+		pd69104_latch_event_faults(priv, snapshot);
+
+	if (chip) {
+		ret = poemgr_smbus_plan_exec(&priv->bus, &priv->chip_plan, snapshot->regs);
+		if (ret)
+			return ret;
+
+		snapshot->chip = 1;
+	}
+
+	return 0;
 }
 
-int pd69104_device_online(struct poemgr_pse_chip *pse_chip)
+int pd69104_snapshot_port_poe_class(const struct poemgr_pse_snapshot *snapshot, int port)
 {
-	int id_reg = pd69104_rr(pse_chip, PD69104_REG_ID);
+	return pd69104_statp_lut[snapshot->regs[pd69104_field_reg(PD69104_FIELD_STATP_DETECTION, port)]].poe_class;
+}
 
-	if (id_reg < 0)
-		return 0;
+static int pd69104_port_sr_faults(int psr)
+{
+	int faults = 0;
 
-	if (((id_reg & PD69104_REG_ID_DEV_MASK) >> PD69104_REG_ID_DEV_SHIFT) != 0x5)
-		return 0;
-	
-	return 1;
+	if (psr & PD69104_REG_PORT_SR_OVER_TEMP)
+		faults |= POEMGR_FAULT_TYPE_OVER_TEMPERATURE;
+
+	if (psr & PD69104_REG_PORT_SR_OFF_PM)
+		faults |= POEMGR_FAULT_TYPE_POWER_MANAGEMENT;
+
+	return faults;
+}
+
+int pd69104_snapshot_port_faults(const struct poemgr_pse_snapshot *snapshot, int port)
+{
+	int statp = snapshot->regs[pd69104_field_reg(PD69104_FIELD_STATP_DETECTION, port)];
+
+	return pd69104_statp_lut[statp].faults | pd69104_port_sr_faults(pd69104_snapshot_port_sr(snapshot, port));
+}
+
+int pd69104_device_online(struct poemgr_pse_chip *pse_chip)
+{
+	return pd69104_field_id_dev_get(pse_chip, 0) == PD69104_REG_ID_DEV_PD69104;
 }
 
 int pd69104_port_power_consumption_get(struct poemgr_pse_chip *pse_chip, int port)
 {
-	return pd69104_rr(pse_chip, PD69104_REG_PORT_CONS(port));
+	return pd69104_field_port_cons_get(pse_chip, port);
 }
 
 int pd69104_pwrgd_pin_status_get(struct poemgr_pse_chip *pse_chip)
 {
-	return (pd69104_rr(pse_chip, PD69104_REG_PWRGD) & PD69104_REG_PWRGD_PIN_STATUS_MASK) >> PD69104_REG_PWRGD_PIN_STATUS_SHIFT;
+	return pd69104_field_pwrgd_pin_status_get(pse_chip, 0);
 }
 
 int pd69104_port_operation_mode_get(struct poemgr_pse_chip *pse_chip, int port)
 {
-	int opmd_reg = pd69104_rr(pse_chip, PD69104_REG_OPMD);
-	int opmd_port = (PD69104_REG_OPMD_PORT_MASK(port) & opmd_reg) >> PD69104_REG_OPMD_PORT_SHIFT(port);
-	if (opmd_reg < 0)
-		return opmd_reg;
-
-	return opmd_port;
+	return pd69104_field_opmd_get(pse_chip, port);
 }
 
 int pd69104_port_operation_mode_set(struct poemgr_pse_chip *pse_chip, int port, int opmode)
 {
-	int opmd_reg = pd69104_rr(pse_chip, PD69104_REG_OPMD);
-
-	if (opmd_reg < 0)
-		return opmd_reg;
-
-	opmd_reg &= ~PD69104_REG_OPMD_PORT_MASK(port);
-	opmd_reg |= opmode << PD69104_REG_OPMD_PORT_SHIFT(port);
-
-	return pd69104_wr(pse_chip, PD69104_REG_OPMD, opmd_reg);
+	return pd69104_field_opmd_set(pse_chip, port, opmode);
 }
 
-int pd69104_port_detection_classification_set(struct poemgr_pse_chip *pse_chip, int port, int enable)
+/* Ports sharing a register are updated by a single read-modify-write */
+int pd69104_ports_operation_mode_set(struct poemgr_pse_chip *pse_chip, uint32_t portmask, int opmode)
 {
-	int detena_reg = pd69104_rr(pse_chip, PD69104_REG_DETENA);
+	uint8_t mask = 0, val = 0;
 
-	if (detena_reg < 0)
-		return detena_reg;
+	for (int port = 0; port < PD69104_NUM_PORTS; port++) {
+		if (!(portmask & (1 << port)))
+			continue;
 
-	detena_reg &= ~PD69104_REG_DETENA_DETECTION_PORT_MASK(port);
-	detena_reg |= !!enable << PD69104_REG_DETENA_DETECTION_PORT_SHIFT(port);
+		mask |= pd69104_field_mask(PD69104_FIELD_OPMD, port);
+		val |= opmode << pd69104_field_shift(PD69104_FIELD_OPMD, port);
+	}
 
-	detena_reg &= ~PD69104_REG_DETENA_CLASSIFICATION_PORT_MASK(port);
-	detena_reg |= !!enable << PD69104_REG_DETENA_CLASSIFICATION_PORT_SHIFT(port);
+	if (!mask)
+		return 0;
 
-	return pd69104_wr(pse_chip, PD69104_REG_DETENA, detena_reg);
+	/* All ports are located in the same register */
+	return pd69104_reg_update(pse_chip, pd69104_field_reg(PD69104_FIELD_OPMD, 0), mask, val);
 }
 
-int pd69104_port_poe_class_get(struct poemgr_pse_chip *pse_chip, int port)
+int pd69104_port_detection_classification_set(struct poemgr_pse_chip *pse_chip, int port, int enable)
 {
-	int statp = pd69104_rr(pse_chip, PD69104_REG_STATP(port));
-	int classification = (statp & PD69104_REG_STATP_CLASSIFICATION_MASK) >> PD69104_REG_STATP_CLASSIFICATION_SHIFT;
+	/* Detection and classification share one register, update both at once */
+	uint8_t mask = pd69104_field_mask(PD69104_FIELD_DETENA_DETECTION, port) |
+		       pd69104_field_mask(PD69104_FIELD_DETENA_CLASSIFICATION, port);
 
-	if (statp < 0)
-		return statp;
+	return pd69104_reg_update(pse_chip, pd69104_field_reg(PD69104_FIELD_DETENA_DETECTION, port),
+				  mask, enable ? mask : 0);
+}
 
-	/**
-	 * 0 = Unknown
-	 * 1 = Class 1
-	 * 2 = Class 2
-	 * 3 = Class 3
-	 * 4 = Class 4
-	 * 5 = Reserved
-	 * 6 = Class 0
-	 * 7 = Over-current
-	 */
+int pd69104_ports_detection_classification_set(struct poemgr_pse_chip *pse_chip, uint32_t portmask, int enable)
+{
+	uint8_t mask = 0;
+
+	for (int port = 0; port < PD69104_NUM_PORTS; port++) {
+		if (!(portmask & (1 << port)))
+			continue;
 
-	if (classification > 0 && classification < 5)
-		return classification;
+		mask |= pd69104_field_mask(PD69104_FIELD_DETENA_DETECTION, port) |
+			pd69104_field_mask(PD69104_FIELD_DETENA_CLASSIFICATION, port);
+	}
 
-	if (classification == 6)
+	if (!mask)
 		return 0;
 
-	return -1;
+	return pd69104_reg_update(pse_chip, pd69104_field_reg(PD69104_FIELD_DETENA_DETECTION, 0),
+				  mask, enable ? mask : 0);
+}
+
+int pd69104_port_poe_class_get(struct poemgr_pse_chip *pse_chip, int port)
+{
+	return pd69104_field_statp_classification_get(pse_chip, port);
 }
 
 int pd69104_port_power_enabled_get(struct poemgr_pse_chip *pse_chip, int port)
 {
-	return !!(PD69104_REG_STATPWR_PWR_ENABLED_PORT_MASK(port) & pd69104_rr(pse_chip, PD69104_REG_STATPWR));
+	return pd69104_field_statpwr_pwr_enabled_get(pse_chip, port);
 }
 
 int pd69104_port_power_good_get(struct poemgr_pse_chip *pse_chip, int port)
 {
-	return !!(PD69104_REG_STATPWR_PWR_GOOD_PORT_MASK(port) & pd69104_rr(pse_chip, PD69104_REG_STATPWR));
+	return pd69104_field_statpwr_pwr_good_get(pse_chip, port);
+}
+
+/* Power-good state of all ports as a bitmask, read in a single transfer */
+int pd69104_ports_power_good_get(struct poemgr_pse_chip *pse_chip)
+{
+	int reg_val, portmask = 0;
+
+	reg_val = pd69104_rr(pse_chip, pd69104_field_reg(PD69104_FIELD_STATPWR_PWR_GOOD, 0));
+	if (reg_val < 0)
+		return reg_val;
+
+	for (int port = 0; port < PD69104_NUM_PORTS; port++) {
+		if (pd69104_field_extract(PD69104_FIELD_STATPWR_PWR_GOOD, port, reg_val))
+			portmask |= 1 << port;
+	}
+
+	return portmask;
 }
 
 int pd69104_port_power_limit_get(struct poemgr_pse_chip *pse_chip, int port)
 {
-	return PD69104_REG_PWR_CR_PAL_MASK & pd69104_rr(pse_chip, PD69104_REG_PWR_CR(port));
+	return pd69104_field_pwr_cr_pal_get(pse_chip, port);
 }
 
 int pd69104_port_power_limit_set(struct poemgr_pse_chip *pse_chip, int port, int val)
 {
-	return pd69104_wr(pse_chip, PD69104_REG_PWR_CR(port), PD69104_REG_PWR_CR_PAL_MASK & val);
+	return pd69104_field_pwr_cr_pal_set(pse_chip, port, val);
 }
 
 int pd69104_system_power_budget_get(struct poemgr_pse_chip *pse_chip, int bank)
 {
-	return pd69104_rr(pse_chip, PD69104_REG_PWR_BNK(bank));
+	return pd69104_field_pwr_bnk_get(pse_chip, bank);
 }
 
 int pd69104_system_power_budget_set(struct poemgr_pse_chip *pse_chip, int bank, int val)
 {
-	return pd69104_wr(pse_chip, PD69104_REG_PWR_BNK(bank), val);
-}
-
-static int pd69104_vtemp_get(struct poemgr_pse_chip *pse_chip)
-{
-	return pd69104_rr(pse_chip, PD69104_REG_VTEMP);
+	return pd69104_field_pwr_bnk_set(pse_chip, bank, val);
 }
 
 int pd69104_port_faults_get(struct poemgr_pse_chip *pse_chip, int port)
 {
+	int statp = pd69104_rr(pse_chip, pd69104_field_reg(PD69104_FIELD_STATP_DETECTION, port));
+	int psr = pd69104_field_read(pse_chip, PD69104_FIELD_PORT_SR, port);
 
-	int psr = (pd69104_rr(pse_chip, PD69104_REG_PORT_SR(port)) & PD69104_REG_PORT_SR_MASK(port)) >> PD69104_REG_PORT_SR_SHIFT(port);
-	int statp = pd69104_rr(pse_chip, PD69104_REG_STATP(port));
-	int detection_result = (statp & PD69104_REG_STATP_DETECTION_MASK) >> PD69104_REG_STATP_DETECTION_SHIFT;
-	int classification_result = (statp & PD69104_REG_STATP_CLASSIFICATION_MASK) >> PD69104_REG_STATP_CLASSIFICATION_SHIFT;
-	int faults = 0;
-
-	if (psr < 0 || statp < 0)
+	if (statp < 0 || psr < 0)
 		return -1;
 
-	switch (detection_result) {
-		case PD69104_REG_STATP_DETECTION_SHORT_CIRCUIT:
-			faults |= POEMGR_FAULT_TYPE_SHORT_CIRCUIT;
-			break;
-		case PD69104_REG_STATP_DETECTION_CPD_TOO_HIGH:
-			faults |= POEMGR_FAULT_TYPE_CAPACITY_TOO_HIGH;
-			break;
-		case PD69104_REG_STATP_DETECTION_RSIG_TOO_LOW:
-			faults |= POEMGR_FAULT_TYPE_RESISTANCE_TOO_LOW;
-			break;
-		case PD69104_REG_STATP_DETECTION_RSIG_TOO_HIGH:
-			faults |= POEMGR_FAULT_TYPE_RESISTANCE_TOO_HIGH;
-			break;		
-		case PD69104_REG_STATP_DETECTION_RSIG_OPEN_CIRCUIT:
-			faults |= POEMGR_FAULT_TYPE_OPEN_CIRCUIT;
-			break;
-		default:
-			break;
-	}
-
-	switch (classification_result) {
-		case PD69104_REG_STATP_CLASSIFICATION_OVER_CURRENT:
-			faults |= POEMGR_FAULT_TYPE_OVER_CURRENT;
-			break;
-		default:
-			break;
-	}
-
-	if (psr & PD69104_REG_PORT_SR_OVER_TEMP) {
-		faults |= POEMGR_FAULT_TYPE_OVER_TEMPERATURE;
-	}
-
-	if (psr & PD69104_REG_PORT_SR_OFF_PM) {
-		faults |= POEMGR_FAULT_TYPE_POWER_MANAGEMENT;
-	}
-
-	return faults;
+	return pd69104_statp_lut[statp].faults | pd69104_port_sr_faults(psr);
 }
 
 int pd69104_export_metric(struct poemgr_pse_chip *pse_chip, struct poemgr_metric *output, int metric)
 {
+	int val;
+
 	if (metric < 0 || metric >= pse_chip->num_metrics)
 		return -1;
 
 	if (metric == 0) {
+		val = pd69104_field_read(pse_chip, PD69104_FIELD_VTEMP, 0);
+		if (val < 0)
+			return -1;
+
 		output->type = POEMGR_METRIC_INT32;
 		output->name = "temperature";
-		output->val_int32 = ((int) pd69104_vtemp_get(pse_chip) * 0.96) - 27;
+		output->val_int32 = pd69104_decode_temperature(val);
+	} else if (metric == 1) {
+		output->type = POEMGR_METRIC_INT32;
+		output->name = "i2c_errors";
+		output->val_int32 = pd69104_priv(pse_chip)->bus.xfer_errors;
+	} else if (metric == 2) {
+		output->type = POEMGR_METRIC_INT32;
+		output->name = "i2c_transfers";
+		output->val_int32 = pd69104_priv(pse_chip)->bus.xfers;
 	}
 
 	return 0;
 }
 
-int pd69104_init(struct poemgr_pse_chip *pse_chip, int i2c_bus, int i2c_addr, uint32_t port_mask)
+static void pd69104_port_status(struct poemgr_pse_chip *pse_chip, const struct poemgr_pse_snapshot *snapshot,
+				int port, struct poemgr_port_status *status)
+{
+	status->power = pd69104_snapshot_port_cons(snapshot, port);
+	status->active = pd69104_snapshot_statpwr_pwr_good(snapshot, port);
+	status->power_limit = pd69104_snapshot_pwr_cr_pal(snapshot, port);
+	status->enabled = pd69104_snapshot_opmd(snapshot, port) == PD69104_REG_OPMD_AUTO;
+	status->poe_class = pd69104_snapshot_port_poe_class(snapshot, port);
+
+	/* Events of faults which may have cleared before this snapshot, reported once */
+	status->latched_faults = pd69104_priv(pse_chip)->latched_faults[port];
+	pd69104_priv(pse_chip)->latched_faults[port] = 0;
+	status->faults = pd69104_snapshot_port_faults(snapshot, port) | status->latched_faults;
+}
+
+static int pd69104_set_port_mode(struct poemgr_pse_chip *pse_chip, uint32_t portmask, enum poemgr_pse_port_mode mode)
+{
+	int ret;
+
+	if (mode == POEMGR_PSE_PORT_MODE_OFF)
+		return pd69104_ports_operation_mode_set(pse_chip, portmask, PD69104_REG_OPMD_SHUTDOWN);
+
+	ret = pd69104_ports_operation_mode_set(pse_chip, portmask, PD69104_REG_OPMD_AUTO);
+	if (ret < 0)
+		return ret;
+
+	/* Shutdown implicitly disables detection as well as classification */
+	return pd69104_ports_detection_classification_set(pse_chip, portmask, 1);
+}
+
+int pd69104_init(struct poemgr_pse_chip *pse_chip, struct poemgr_arena *arena, int i2c_bus, int i2c_addr, uint32_t port_mask)
 {
 	struct pd69104_priv *priv;
-	char i2cpath[30];
-	int fd;
 
-	priv = malloc(sizeof(struct pd69104_priv));
+	/* Released together with the configuration generation */
+	priv = poemgr_arena_alloc(arena, sizeof(struct pd69104_priv));
 	if (!priv)
 		return 1;
 
-	priv->i2c_addr = i2c_addr;
+	for (uint32_t mask = 0; mask < (1 << PD69104_NUM_PORTS); mask++)
+		pd69104_read_plan_build(&priv->port_plans[mask], mask, 0);
+	pd69104_read_plan_build(&priv->chip_plan, 0, 1);
+	memset(priv->latched_faults, 0, sizeof(priv->latched_faults));
+
+	pse_chip->priv = (void *) priv;
+	pse_chip->portmask = port_mask;
+	pse_chip->model = "PD69104";
+	pse_chip->num_budget_banks = PD69104_REG_PWR_BNK_NUM_BANKS;
+	pse_chip->num_metrics = 3;
 
-	snprintf(i2cpath, 30, "/dev/i2c-%d", i2c_bus);
+	return poemgr_smbus_open(&priv->bus, arena, pse_chip->model, i2c_bus, i2c_addr, PD69104_SIM);
+}
 
-	fd = open(i2cpath, O_RDWR);
+int pd69104_degraded(struct poemgr_pse_chip *pse_chip)
+{
+	return pd69104_priv(pse_chip)->bus.degraded;
+}
 
-	if (fd == -1) {
-		perror(i2cpath);
-		goto err_free_priv;
+int pd69104_end(struct poemgr_pse_chip *pse_chip)
+{
+	/* priv is owned by the configuration arena */
+	return poemgr_smbus_close(&pd69104_priv(pse_chip)->bus);
+}
+
+const struct poemgr_pse_ops pd69104_pse_ops = {
+	.init = &pd69104_init,
+	.end = &pd69104_end,
+	.online = &pd69104_device_online,
+	.snapshot = &pd69104_snapshot,
+	.port_status = &pd69104_port_status,
+	.set_port_mode = &pd69104_set_port_mode,
+	.get_power_good = &pd69104_ports_power_good_get,
+	.set_limits = &pd69104_port_power_limit_set,
+	.set_budget = &pd69104_system_power_budget_set,
+	.export_metric = &pd69104_export_metric,
+};
+
+#ifdef POEMGR_SIM
+/* Simulator */
+
+#define PD69104_SIM_ID			(PD69104_REG_ID_DEV_PD69104 << 3 | 0x4)
+#define PD69104_SIM_VTEMP		((POEMGR_SIM_TEMPERATURE + 27) * 100 / 96)
+
+struct pd69104_sim_state {
+	uint8_t regs[PD69104_NUM_REGS];
+	struct poemgr_sim_port ports[PD69104_NUM_PORTS];
+};
+
+static void pd69104_sim_init(void *state)
+{
+	struct pd69104_sim_state *sim = state;
+
+	memset(sim->regs, 0, sizeof(sim->regs));
+	sim->regs[pd69104_field_reg(PD69104_FIELD_ID_DEV, 0)] = PD69104_SIM_ID;
+	sim->regs[pd69104_field_reg(PD69104_FIELD_VTEMP, 0)] = PD69104_SIM_VTEMP;
+	sim->regs[pd69104_field_reg(PD69104_FIELD_OPMD, 0)] = 0xFF;
+	sim->regs[pd69104_field_reg(PD69104_FIELD_DETENA_DETECTION, 0)] = 0xFF;
+
+	for (int port = 0; port < PD69104_NUM_PORTS; port++)
+		poemgr_sim_port_reset(&sim->ports[port]);
+}
+
+static uint8_t pd69104_sim_statp(struct pd69104_sim_state *sim, int port)
+{
+	int poe_class = poemgr_sim_pd_get(port)->poe_class;
+
+	switch (poemgr_sim_port_state(&sim->ports[port], port)) {
+		case POEMGR_SIM_PD_OPEN:
+			return PD69104_REG_STATP_DETECTION_RSIG_OPEN_CIRCUIT;
+		case POEMGR_SIM_PD_CLASSIFYING:
+			return PD69104_REG_STATP_DETECTION_GOOD;
+		case POEMGR_SIM_PD_POWERING:
+		case POEMGR_SIM_PD_POWERED:
+			if (!poe_class)
+				poe_class = PD69104_REG_STATP_CLASSIFICATION_CLASS_0;
+			return PD69104_REG_STATP_DETECTION_GOOD | poe_class << 4;
+		default:
+			return 0;
 	}
+}
 
-	if (ioctl(fd, I2C_SLAVE, priv->i2c_addr) < 0) {
-		perror("i2c_set_address");
-		goto err_close_fd;
+static uint8_t pd69104_sim_statpwr(struct pd69104_sim_state *sim)
+{
+	uint8_t val = 0;
+
+	for (int port = 0; port < PD69104_NUM_PORTS; port++) {
+		switch (poemgr_sim_port_state(&sim->ports[port], port)) {
+			case POEMGR_SIM_PD_POWERED:
+				val |= pd69104_field_mask(PD69104_FIELD_STATPWR_PWR_GOOD, port);
+				/* fallthrough */
+			case POEMGR_SIM_PD_POWERING:
+				val |= pd69104_field_mask(PD69104_FIELD_STATPWR_PWR_ENABLED, port);
+				break;
+			default:
+				break;
+		}
 	}
 
-	priv->i2c_fd = fd;
+	return val;
+}
 
-	pse_chip->priv = (void *) priv;
-	pse_chip->portmask = port_mask;
-	pse_chip->model = "PD69104";
-	pse_chip->num_metrics = 1;
-	pse_chip->export_metric = &pd69104_export_metric;
+static uint8_t pd69104_sim_read(void *state, uint8_t reg)
+{
+	struct pd69104_sim_state *sim = state;
+	int port;
 
-	return 0;
+	for (port = 0; port < PD69104_NUM_PORTS; port++) {
+		if (reg == pd69104_field_reg(PD69104_FIELD_STATP_DETECTION, port))
+			return pd69104_sim_statp(sim, port);
 
-err_close_fd:
-	close(fd);
-err_free_priv:
-	free(priv);
+		/* Watts */
+		if (reg == pd69104_field_reg(PD69104_FIELD_PORT_CONS, port))
+			return (int64_t) poemgr_sim_port_current(&sim->ports[port], port) *
+			       POEMGR_SIM_PORT_VOLTAGE / 1000000000;
+	}
 
-	return 1;
+	if (reg == pd69104_field_reg(PD69104_FIELD_STATPWR_PWR_GOOD, 0))
+		return pd69104_sim_statpwr(sim);
+
+	return sim->regs[reg];
 }
 
-int pd69104_end(struct poemgr_pse_chip *pse_chip)
+static void pd69104_sim_write(void *state, uint8_t reg, uint8_t val)
 {
-	struct pd69104_priv *priv = pd69104_priv(pse_chip);
-	int ret = !!close(priv->i2c_fd);
+	struct pd69104_sim_state *sim = state;
+	uint8_t opmd_reg = pd69104_field_reg(PD69104_FIELD_OPMD, 0);
+	uint8_t detena_reg = pd69104_field_reg(PD69104_FIELD_DETENA_DETECTION, 0);
+	int opmode;
+
+	sim->regs[reg] = val;
+
+	if (reg != opmd_reg && reg != detena_reg)
+		return;
 
-	free(priv);
-	return ret;
+	for (int port = 0; port < PD69104_NUM_PORTS; port++) {
+		opmode = pd69104_field_extract(PD69104_FIELD_OPMD, port, sim->regs[opmd_reg]);
+
+		/* Shutdown implicitly disables detection as well as classification */
+		if (opmode == PD69104_REG_OPMD_SHUTDOWN)
+			sim->regs[detena_reg] &= ~(pd69104_field_mask(PD69104_FIELD_DETENA_DETECTION, port) |
+						  pd69104_field_mask(PD69104_FIELD_DETENA_CLASSIFICATION, port));
+
+		poemgr_sim_port_enable(&sim->ports[port], opmode == PD69104_REG_OPMD_AUTO &&
+				       pd69104_field_extract(PD69104_FIELD_DETENA_DETECTION, port, sim->regs[detena_reg]));
+	}
 }
+
+const struct poemgr_smbus_sim pd69104_sim = {
+	.state_size = sizeof(struct pd69104_sim_state),
+	.init = &pd69104_sim_init,
+	.read = &pd69104_sim_read,
+	.write = &pd69104_sim_write,
+};
+#endif
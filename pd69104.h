@@ -5,19 +5,55 @@
 #include <stdint.h>
 
 #include "poemgr.h"
+#include "pd69104_regs.h"
+#include "pse.h"
+#include "smbus.h"
 
 struct pd69104_priv {
-	int i2c_fd;
+	struct poemgr_smbus bus;
 
-	int i2c_addr;
+	/* Read plans indexed by port mask, chip-wide fields */
+	struct poemgr_smbus_read_plan port_plans[1 << PD69104_NUM_PORTS];
+	struct poemgr_smbus_read_plan chip_plan;
+
+	/* Faults of the event registers not yet reported by port_status, per port */
+	uint16_t latched_faults[PD69104_NUM_PORTS];
 };
 
-int pd69104_init(struct poemgr_pse_chip *pse_chip, int i2c_bus, int i2c_addr, uint32_t port_mask);
+extern const struct poemgr_pse_ops pd69104_pse_ops;
+
+#ifdef POEMGR_SIM
+/* Register model of the chip for --simulate */
+extern const struct poemgr_smbus_sim pd69104_sim;
+#define PD69104_SIM	(&pd69104_sim)
+#else
+#define PD69104_SIM	NULL
+#endif
+
+/* Decoded field values from a snapshot: pd69104_snapshot_<field>(snap, port) */
+#define PD69104_SNAPSHOT_GETTER(NAME, name, reg, per_reg, idx_shift, shift, width, access, snap, decode) \
+static inline int pd69104_snapshot_##name(const struct poemgr_pse_snapshot *snapshot, int idx) \
+{ \
+	return pd69104_decode_##decode(pd69104_field_extract(PD69104_FIELD_##NAME, idx, \
+				       snapshot->regs[pd69104_field_reg(PD69104_FIELD_##NAME, idx)])); \
+}
+PD69104_FIELDS(PD69104_SNAPSHOT_GETTER)
+#undef PD69104_SNAPSHOT_GETTER
+
+int pd69104_init(struct poemgr_pse_chip *pse_chip, struct poemgr_arena *arena, int i2c_bus, int i2c_addr, uint32_t port_mask);
 
 int pd69104_end(struct poemgr_pse_chip *pse_chip);
 
 int pd69104_device_online(struct poemgr_pse_chip *pse_chip);
 
+int pd69104_degraded(struct poemgr_pse_chip *pse_chip);
+
+int pd69104_snapshot(struct poemgr_pse_chip *pse_chip, struct poemgr_pse_snapshot *snapshot, uint32_t portmask, int chip);
+
+int pd69104_snapshot_port_poe_class(const struct poemgr_pse_snapshot *snapshot, int port);
+
+int pd69104_snapshot_port_faults(const struct poemgr_pse_snapshot *snapshot, int port);
+
 int pd69104_port_power_consumption_get(struct poemgr_pse_chip *pse_chip, int port);
 
 int pd69104_pwrgd_pin_status_get(struct poemgr_pse_chip *pse_chip);
@@ -26,14 +62,20 @@ int pd69104_port_operation_mode_get(struct poemgr_pse_chip *pse_chip, int port);
 
 int pd69104_port_operation_mode_set(struct poemgr_pse_chip *pse_chip, int port, int opmode);
 
+int pd69104_ports_operation_mode_set(struct poemgr_pse_chip *pse_chip, uint32_t portmask, int opmode);
+
 int pd69104_port_detection_classification_set(struct poemgr_pse_chip *pse_chip, int port, int enable);
 
+int pd69104_ports_detection_classification_set(struct poemgr_pse_chip *pse_chip, uint32_t portmask, int enable);
+
 int pd69104_port_poe_class_get(struct poemgr_pse_chip *pse_chip, int port);
 
 int pd69104_port_power_enabled_get(struct poemgr_pse_chip *pse_chip, int port);
 
 int pd69104_port_power_good_get(struct poemgr_pse_chip *pse_chip, int port);
 
+int pd69104_ports_power_good_get(struct poemgr_pse_chip *pse_chip);
+
 int pd69104_port_power_limit_get(struct poemgr_pse_chip *pse_chip, int port);
 
 int pd69104_port_power_limit_set(struct poemgr_pse_chip *pse_chip, int port, int val);
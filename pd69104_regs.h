@@ -2,85 +2,185 @@
 
 #pragma once
 
+#include <stdint.h>
+
 /**
  * See Microsemi_PoE_PD69104B1_Generic_UG_Reg_Map.pdf
  *
  * http://ww1.microchip.com/downloads/en/DeviceDoc/Microsemi_PoE_PD69104B1_Generic_UG_Reg_Map.pdf
  */
 
-#define GENMASK(h, l) \
-	(((~0UL) << (l)) & (~0UL >> (32 - 1 - (h))))
-
+#define PD69104_NUM_PORTS		4
+#define PD69104_NUM_REGS		0x100
 
-#define PD69104_REG_STATP(x)							(0xC + x)
-#define PD69104_REG_STATP_DETECTION_MASK				0x07
-#define PD69104_REG_STATP_DETECTION_SHIFT				0x0
+/**
+ * Register field table
+ *
+ * X(NAME, name, reg, per_reg, idx_shift, shift, width, access, snap, decode)
+ *
+ * reg:       Register address of the field for port (or bank) 0
+ * per_reg:   Number of ports sharing one register. The register address
+ *            increments after per_reg ports. 0 for chip-wide fields.
+ * idx_shift: Bit offset between ports sharing one register
+ * shift:     Bit offset of the field for the first port in a register
+ * width:     Field width in bits
+ * access:    RO / RW / COR (read-only, cleared by reading)
+ * snap:      Part of the status snapshot (PORT / CHIP) or not (NONE). EVENT
+ *            fields are read with every port snapshot, as reading them clears
+ *            the events of all ports.
+ * decode:    Decode function applied by the generated getter
+ */
+#define PD69104_FIELDS(X) \
+	X(FLTEVN_COR_ICUT,		fltevn_cor_icut,	0x07, 4, 1, 0, 1, COR, EVENT, raw) \
+	X(TSEVN_COR_TSTART,		tsevn_cor_tstart,	0x09, 4, 1, 0, 1, COR, EVENT, raw) \
+	X(TSEVN_COR_ILIM,		tsevn_cor_ilim,		0x09, 4, 1, 4, 1, COR, EVENT, raw) \
+	X(SUPEVN_COR_TSD,		supevn_cor_tsd,		0x0B, 0, 0, 7, 1, COR, EVENT, raw) \
+	X(STATP_DETECTION,		statp_detection,	0x0C, 1, 0, 0, 3, RO, PORT, raw) \
+	X(STATP_CLASSIFICATION,		statp_classification,	0x0C, 1, 0, 4, 3, RO, PORT, class) \
+	X(STATPWR_PWR_ENABLED,		statpwr_pwr_enabled,	0x10, 4, 1, 0, 1, RO, PORT, raw) \
+	X(STATPWR_PWR_GOOD,		statpwr_pwr_good,	0x10, 4, 1, 4, 1, RO, PORT, raw) \
+	X(OPMD,				opmd,			0x12, 4, 2, 0, 2, RW, PORT, raw) \
+	X(DETENA_DETECTION,		detena_detection,	0x14, 4, 1, 0, 1, RW, NONE, raw) \
+	X(DETENA_CLASSIFICATION,	detena_classification,	0x14, 4, 1, 4, 1, RW, NONE, raw) \
+	X(ID_REV,			id_rev,			0x1B, 0, 0, 0, 3, RO, NONE, raw) \
+	X(ID_DEV,			id_dev,			0x1B, 0, 0, 3, 5, RO, NONE, raw) \
+	X(FIRMWARE,			firmware,		0x41, 0, 0, 0, 8, RO, NONE, raw) \
+	X(DEVID,			devid,			0x43, 0, 0, 0, 8, RO, NONE, raw) \
+	X(VTEMP,			vtemp,			0x70, 0, 0, 0, 8, RO, CHIP, temperature) \
+	X(PORT_SR,			port_sr,		0x75, 2, 4, 0, 4, RO, PORT, raw) \
+	X(PRIO_CR,			prio_cr,		0x80, 0, 0, 0, 8, RW, NONE, raw) \
+	X(PWR_CR_PAL,			pwr_cr_pal,		0x81, 1, 0, 0, 6, RW, PORT, raw) \
+	X(PWR_BNK,			pwr_bnk,		0x89, 1, 0, 0, 8, RW, NONE, raw) \
+	X(PWRGD_PIN_STATUS,		pwrgd_pin_status,	0x91, 0, 0, 3, 4, RO, CHIP, raw) \
+	X(PORT_CONS,			port_cons,		0x92, 1, 0, 0, 8, RO, PORT, raw)
+
+enum pd69104_field {
+#define PD69104_FIELD_ENUM(NAME, name, reg, per_reg, idx_shift, shift, width, access, snap, decode) \
+	PD69104_FIELD_##NAME,
+	PD69104_FIELDS(PD69104_FIELD_ENUM)
+#undef PD69104_FIELD_ENUM
+	PD69104_NUM_FIELDS,
+};
+
+enum pd69104_field_access {
+	PD69104_ACCESS_RO,
+	PD69104_ACCESS_RW,
+	PD69104_ACCESS_COR,
+};
+
+enum pd69104_field_snap {
+	PD69104_SNAP_NONE,
+	PD69104_SNAP_PORT,
+	PD69104_SNAP_CHIP,
+	PD69104_SNAP_EVENT,
+};
+
+struct pd69104_field_desc {
+	uint8_t reg;
+	uint8_t per_reg;
+	uint8_t idx_shift;
+	uint8_t shift;
+	uint8_t width;
+	uint8_t access;
+	uint8_t snap;
+};
+
+static const struct pd69104_field_desc pd69104_fields[PD69104_NUM_FIELDS] = {
+#define PD69104_FIELD_DESC(NAME, name, _reg, _per_reg, _idx_shift, _shift, _width, _access, _snap, decode) \
+	[PD69104_FIELD_##NAME] = { \
+		.reg = _reg, \
+		.per_reg = _per_reg, \
+		.idx_shift = _idx_shift, \
+		.shift = _shift, \
+		.width = _width, \
+		.access = PD69104_ACCESS_##_access, \
+		.snap = PD69104_SNAP_##_snap, \
+	},
+	PD69104_FIELDS(PD69104_FIELD_DESC)
+#undef PD69104_FIELD_DESC
+};
+
+static inline uint8_t pd69104_field_reg(enum pd69104_field field, int idx)
+{
+	const struct pd69104_field_desc *desc = &pd69104_fields[field];
+
+	if (!desc->per_reg)
+		return desc->reg;
+
+	return desc->reg + idx / desc->per_reg;
+}
+
+static inline int pd69104_field_shift(enum pd69104_field field, int idx)
+{
+	const struct pd69104_field_desc *desc = &pd69104_fields[field];
+
+	if (!desc->per_reg)
+		return desc->shift;
+
+	return desc->shift + (idx % desc->per_reg) * desc->idx_shift;
+}
+
+static inline uint8_t pd69104_field_mask(enum pd69104_field field, int idx)
+{
+	return ((1 << pd69104_fields[field].width) - 1) << pd69104_field_shift(field, idx);
+}
+
+static inline int pd69104_field_extract(enum pd69104_field field, int idx, uint8_t reg_val)
+{
+	return (reg_val & pd69104_field_mask(field, idx)) >> pd69104_field_shift(field, idx);
+}
+
+/* Field values */
+#define PD69104_REG_STATP_DETECTION_UNKNOWN				0x0
 #define PD69104_REG_STATP_DETECTION_SHORT_CIRCUIT		0x1
 #define PD69104_REG_STATP_DETECTION_CPD_TOO_HIGH		0x2
 #define PD69104_REG_STATP_DETECTION_RSIG_TOO_LOW		0x3
 #define PD69104_REG_STATP_DETECTION_GOOD				0x4
 #define PD69104_REG_STATP_DETECTION_RSIG_TOO_HIGH		0x5
 #define PD69104_REG_STATP_DETECTION_RSIG_OPEN_CIRCUIT	0x6
-#define PD69104_REG_STATP_CLASSIFICATION_MASK			0x70
-#define PD69104_REG_STATP_CLASSIFICATION_SHIFT			0x4
-#define PD69104_REG_STATP_CLASSIFICATION_OVER_CURRENT	0x7
 
+#define PD69104_REG_STATP_CLASSIFICATION_UNKNOWN		0x0
+#define PD69104_REG_STATP_CLASSIFICATION_CLASS_0		0x6
+#define PD69104_REG_STATP_CLASSIFICATION_OVER_CURRENT	0x7
 
-#define PD69104_REG_STATPWR								0x10
-#define PD69104_REG_STATPWR_PWR_ENABLED_MASK			0xF
-#define PD69104_REG_STATPWR_PWR_ENABLED_SHIFT			0x0
-#define PD69104_REG_STATPWR_PWR_ENABLED_PORT_MASK(x)	(0x1 << (PD69104_REG_STATPWR_PWR_ENABLED_SHIFT + x))
-#define PD69104_REG_STATPWR_PWR_GOOD_MASK				0xF0
-#define PD69104_REG_STATPWR_PWR_GOOD_SHIFT				0x4
-#define PD69104_REG_STATPWR_PWR_GOOD_PORT_MASK(x)		(0x1 << (PD69104_REG_STATPWR_PWR_GOOD_SHIFT + x))
+/**
+ * 0 = Unknown
+ * 1 = Class 1
+ * 2 = Class 2
+ * 3 = Class 3
+ * 4 = Class 4
+ * 5 = Reserved
+ * 6 = Class 0
+ * 7 = Over-current
+ */
+#define PD69104_CLASSIFICATION_TO_CLASS(c) \
+	((c) > 0 && (c) < 5 ? (c) : (c) == PD69104_REG_STATP_CLASSIFICATION_CLASS_0 ? 0 : -1)
 
-#define PD69104_REG_OPMD							0x12
-#define PD69104_REG_OPMD_PORT_SHIFT(x)				(0x2 * x)
-#define PD69104_REG_OPMD_PORT_MASK(x)				(0x3 << PD69104_REG_OPMD_PORT_SHIFT(x))
 #define PD69104_REG_OPMD_SHUTDOWN					0x0
 #define PD69104_REG_OPMD_MANUAL						0x1
 #define PD69104_REG_OPMD_SEMI_AUTO					0x2
 #define PD69104_REG_OPMD_AUTO						0x3
 
-#define PD69104_REG_DETENA								0x14
-#define PD69104_REG_DETENA_DETECTION_PORT_SHIFT(x)		(x)
-#define PD69104_REG_DETENA_DETECTION_PORT_MASK(x)		(1 << PD69104_REG_DETENA_DETECTION_PORT_SHIFT(x))
-#define PD69104_REG_DETENA_CLASSIFICATION_PORT_SHIFT(x)	(4 + x)
-#define PD69104_REG_DETENA_CLASSIFICATION_PORT_MASK(x)	(1 << PD69104_REG_DETENA_CLASSIFICATION_PORT_SHIFT(x))
-
-#define PD69104_REG_ID				0x1B
-#define PD69104_REG_ID_REV_MASK		0x7
-#define PD69104_REG_ID_REV_SHIFT	0x0
-#define PD69104_REG_ID_DEV_MASK		0xF8
-#define PD69104_REG_ID_DEV_SHIFT	0x3
-
-#define PD69104_REG_FIRMWARE			0x41
+#define PD69104_REG_ID_DEV_PD69104					0x5
 
-#define PD69104_REG_DEVID				0x43
-
-/* Extended Auto Mode only */
-#define PD69104_REG_VTEMP				0x70
-
-#define PD69104_REG_PORT_SR_BASE		0x75
-#define PD69104_REG_PORT_SR(x)			(PD69104_REG_PORT_SR_BASE + (x < 3 ? 0 : 1))
-#define PD69104_REG_PORT_SR_MASK(x)		((x % 2) == 0 ? 0x0F : 0xF0)
-#define PD69104_REG_PORT_SR_SHIFT(x)	((x % 2) == 0 ? 0 : 4)
 #define PD69104_REG_PORT_SR_OVER_TEMP		0x1
 #define PD69104_REG_PORT_SR_OFF_PM			0x2
 
-#define PD69104_REG_PRIO_CR				0x80
-
-#define PD69104_REG_PWR_CR_BASE			0x81
-#define PD69104_REG_PWR_CR(x)			(PD69104_REG_PWR_CR_BASE + x)
-#define PD69104_REG_PWR_CR_PAL_MASK		GENMASK(5, 0)
+/* One bank per state of PGD[2:0], PWR_BNK0-7 */
+#define PD69104_REG_PWR_BNK_NUM_BANKS	8
 
-#define PD69104_REG_PWR_BNK_BASE		0x89
-#define PD69104_REG_PWR_BNK_NUM_BANKS	0x7
-#define PD69104_REG_PWR_BNK(x)			(PD69104_REG_PWR_BNK_BASE + x)
+/* Field decode functions */
+static inline int pd69104_decode_raw(int val)
+{
+	return val;
+}
 
-#define PD69104_REG_PWRGD						0x91
-#define PD69104_REG_PWRGD_PIN_STATUS_MASK		GENMASK(6, 3)
-#define PD69104_REG_PWRGD_PIN_STATUS_SHIFT		3
+static inline int pd69104_decode_class(int val)
+{
+	return PD69104_CLASSIFICATION_TO_CLASS(val);
+}
 
-#define PD69104_REG_PORT_CONS_BASE		0x92
-#define PD69104_REG_PORT_CONS(x)			(PD69104_REG_PORT_CONS_BASE + x)
+static inline int pd69104_decode_temperature(int val)
+{
+	return (val * 0.96) - 27;
+}
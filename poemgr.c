@@ -1,5 +1,8 @@
 /* SPDX-License-Identifier: GPL-2.0-only */
 
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,13 +11,41 @@
 #include <json.h>
 
 #include "poemgr.h"
+#include "pse.h"
+#include "bringup.h"
+#include "cache.h"
+#include "capture.h"
+#include "daemon.h"
+#include "journal.h"
+#include "scheduler.h"
+#include "smbus.h"
+#include "thermal.h"
+#include "trace.h"
+
+#ifdef POEMGR_PROFILE
+#define _poemgr_profile_struct(profile)		poemgr_profile_##profile
+#define poemgr_profile_struct(profile)		_poemgr_profile_struct(profile)
+
+extern struct poemgr_profile poemgr_profile_struct(POEMGR_PROFILE);
 
+static struct poemgr_profile *poemgr_profiles[] = {
+	&poemgr_profile_struct(POEMGR_PROFILE),
+	NULL
+};
+#else
 extern struct poemgr_profile poemgr_profile_uswflex;
+#ifdef POEMGR_SIM
+extern struct poemgr_profile poemgr_profile_simtps23861;
+#endif
 
 static struct poemgr_profile *poemgr_profiles[] = {
 	&poemgr_profile_uswflex,
+#ifdef POEMGR_SIM
+	&poemgr_profile_simtps23861,
+#endif
 	NULL
 };
+#endif
 
 static int uci_lookup_option_int(struct uci_context* uci, struct uci_section* s,
 								 const char* name)
@@ -25,7 +56,7 @@ static int uci_lookup_option_int(struct uci_context* uci, struct uci_section* s,
 
 static int poemgr_load_port_settings(struct poemgr_ctx *ctx, struct uci_context *uci_ctx)
 {
-	const char *disabled, *port, *name;
+	const char *disabled, *port, *name, *priority;
 	struct uci_package *package;
 	struct uci_element *e;
 	struct uci_section *s;
@@ -48,6 +79,7 @@ static int poemgr_load_port_settings(struct poemgr_ctx *ctx, struct uci_context
 		port = uci_lookup_option_string(uci_ctx, s, "port");
 		name = uci_lookup_option_string(uci_ctx, s, "name");
 		disabled = uci_lookup_option_string(uci_ctx, s, "disabled");
+		priority = uci_lookup_option_string(uci_ctx, s, "priority");
 
 		if (!port) {
 			ret = 1;
@@ -59,18 +91,48 @@ static int poemgr_load_port_settings(struct poemgr_ctx *ctx, struct uci_context
 			/* No port specified */
 			ret = 1;
 			goto out;
-		} else if (port_idx >= ctx->profile->num_ports) {
+		} else if (port_idx >= poemgr_profile_num_ports(ctx)) {
 			/* Port does not exist. Ignore. */
 			continue;
 		}
 
-		ctx->ports[port_idx].settings.name =  name ? strdup(name) : strdup(port);
+		ctx->ports[port_idx].settings.name = poemgr_arena_strdup(&ctx->arena, name ? name : port);
+		if (!ctx->ports[port_idx].settings.name) {
+			ret = 1;
+			goto out;
+		}
+
 		ctx->ports[port_idx].settings.disabled = disabled ? !!atoi(disabled) : 0;
+		ctx->ports[port_idx].settings.priority_set = !!priority;
+
+		if (!priority || !strcmp(priority, "low")) {
+			ctx->ports[port_idx].settings.priority = POEMGR_PORT_PRIORITY_LOW;
+		} else if (!strcmp(priority, "high")) {
+			ctx->ports[port_idx].settings.priority = POEMGR_PORT_PRIORITY_HIGH;
+		} else if (!strcmp(priority, "critical")) {
+			ctx->ports[port_idx].settings.priority = POEMGR_PORT_PRIORITY_CRITICAL;
+		} else {
+			fprintf(stderr, "Invalid priority %s for port %d\n", priority, port_idx);
+			ret = 1;
+			goto out;
+		}
 	}
 out:
 	return ret;
 }
 
+/* Release all allocations of the current configuration generation */
+static void poemgr_reset_settings(struct poemgr_ctx *ctx)
+{
+	memset(&ctx->settings, 0, sizeof(ctx->settings));
+
+	for (int i = 0; i < POEMGR_MAX_PORTS; i++)
+		memset(&ctx->ports[i].settings, 0, sizeof(ctx->ports[i].settings));
+
+	poemgr_cache_release(ctx);
+	poemgr_arena_reset(&ctx->arena);
+}
+
 int poemgr_load_settings(struct poemgr_ctx *ctx, struct uci_context *uci_ctx)
 {
 	struct uci_package *package;
@@ -96,6 +158,13 @@ int poemgr_load_settings(struct poemgr_ctx *ctx, struct uci_context *uci_ctx)
 
 	ctx->settings.disabled = !!(uci_lookup_option_int(uci_ctx, section, "disabled") > 0);
 	ctx->settings.power_budget = uci_lookup_option_int(uci_ctx, section, "power_budget");
+	ctx->settings.poll_interval_min = uci_lookup_option_int(uci_ctx, section, "poll_interval_min");
+	ctx->settings.poll_interval_max = uci_lookup_option_int(uci_ctx, section, "poll_interval_max");
+	ctx->settings.poll_interval_pse = uci_lookup_option_int(uci_ctx, section, "poll_interval_pse");
+	ctx->settings.thermal_derate_temp = uci_lookup_option_int(uci_ctx, section, "thermal_derate_temp");
+	ctx->settings.thermal_shed_temp = uci_lookup_option_int(uci_ctx, section, "thermal_shed_temp");
+	ctx->settings.thermal_hysteresis = uci_lookup_option_int(uci_ctx, section, "thermal_hysteresis");
+	ctx->settings.thermal_derate_limit = uci_lookup_option_int(uci_ctx, section, "thermal_derate_limit");
 
 	s = uci_lookup_option_string(uci_ctx, section, "profile");
 	if (!s) {
@@ -103,68 +172,195 @@ int poemgr_load_settings(struct poemgr_ctx *ctx, struct uci_context *uci_ctx)
 		goto out;
 	}
 
-	ctx->settings.profile = strdup(s);
+	ctx->settings.profile = poemgr_arena_strdup(&ctx->arena, s);
+	if (!ctx->settings.profile)
+		ret = -1;
 
 out:
 	return ret;
 }
 
+static int poemgr_select_profile(struct poemgr_ctx *ctx)
+{
+	int i;
+
+	/* Switching the profile requires a restart */
+	if (ctx->profile) {
+		if (strcmp(ctx->profile->name, ctx->settings.profile)) {
+			fprintf(stderr, "Profile changed. Restart required.\n");
+			return 1;
+		}
+
+		return 0;
+	}
+
+	for (i = 0; poemgr_profiles[i]; i++) {
+		if (!strcmp(poemgr_profiles[i]->name, ctx->settings.profile)) {
+			ctx->profile = poemgr_profiles[i];
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* Load settings from the config cache, parse the UCI config if it is stale */
+static int poemgr_load_config(struct poemgr_ctx *ctx)
+{
+	struct poemgr_cache_file_id config;
+	struct uci_package *package;
+	int64_t span;
+	int ret;
+
+	span = poemgr_trace_begin();
+	ret = poemgr_cache_load(ctx, &config);
+	poemgr_trace_end(span, "poemgr", "cache load", 1, "result", ret);
+	if (!ret)
+		return poemgr_select_profile(ctx);
+
+	span = poemgr_trace_begin();
+	if (!ctx->uci_ctx) {
+		ctx->uci_ctx = uci_alloc_context();
+	} else {
+		/* Drop cached package, otherwise UCI won't read the file again */
+		package = uci_lookup_package(ctx->uci_ctx, "poemgr");
+		if (package)
+			uci_unload(ctx->uci_ctx, package);
+	}
+
+	ret = poemgr_load_settings(ctx, ctx->uci_ctx);
+	if (!ret)
+		ret = poemgr_select_profile(ctx);
+
+	/* Load port settings (requires selected profile) */
+	if (!ret)
+		ret = poemgr_load_port_settings(ctx, ctx->uci_ctx);
+	poemgr_trace_end(span, "poemgr", "uci load", 1, "result", ret);
+	if (ret)
+		return ret;
+
+	poemgr_cache_store(ctx, &config);
+
+	return 0;
+}
+
 static json_object *poemgr_create_port_fault_array(int faults)
 {
 	struct json_object *arr = json_object_new_array();
+	int fault;
 
-	if (faults & POEMGR_FAULT_TYPE_POWER_MANAGEMENT)
-		json_object_array_add(arr, json_object_new_string("power-budget-exceeded"));
-	if (faults & POEMGR_FAULT_TYPE_OVER_TEMPERATURE)
-		json_object_array_add(arr, json_object_new_string("over-temperature"));
-	if (faults & POEMGR_FAULT_TYPE_SHORT_CIRCUIT)
-		json_object_array_add(arr, json_object_new_string("short-circuit"));
-	if (faults & POEMGR_FAULT_TYPE_RESISTANCE_TOO_LOW)
-		json_object_array_add(arr, json_object_new_string("resistance-too-low"));
-	if (faults & POEMGR_FAULT_TYPE_RESISTANCE_TOO_HIGH)
-		json_object_array_add(arr, json_object_new_string("resistance-too-high"));
-	if (faults & POEMGR_FAULT_TYPE_CAPACITY_TOO_HIGH)
-		json_object_array_add(arr, json_object_new_string("capacity-too-high"));
-	if (faults & POEMGR_FAULT_TYPE_OPEN_CIRCUIT)
-		json_object_array_add(arr, json_object_new_string("open-circuit"));
-	if (faults & POEMGR_FAULT_TYPE_OVER_CURRENT)
-		json_object_array_add(arr, json_object_new_string("over-current"));
-	if (faults & POEMGR_FAULT_TYPE_UNKNOWN)
-		json_object_array_add(arr, json_object_new_string("unknown"));
+	poemgr_for_each_port_fault(fault) {
+		if (faults & fault)
+			json_object_array_add(arr, json_object_new_string(poemgr_port_fault_to_string(fault)));
+	}
 
 	return arr;
 }
 
-int poemgr_show(struct poemgr_ctx *ctx)
+int poemgr_update_port_status(struct poemgr_ctx *ctx, int port)
 {
-	struct json_object *root_obj, *ports_obj, *port_obj, *pse_arr, *pse_obj, *input_obj, *output_obj;
-	struct poemgr_pse_chip *pse_chip;
-	struct poemgr_metric metric_buf;
-	char port_idx[3];
-	int ret = 0;
+	int ret;
 
-	if(!ctx->profile->ready(ctx)) {
-		fprintf(stderr, "Profile disabled. Enable profile first.\n");
-		return 1;
-	}
+	ret = poemgr_profile_cb(ctx, update_port_status)(ctx, port);
+	if (ret)
+		return ret;
 
-	/* Update port status */
-	for (int p_idx = 0; p_idx < ctx->profile->num_ports; p_idx++) {
-		ret = ctx->profile->update_port_status(ctx, p_idx);
-		if (ret)
-			return ret;
-	}
+	/* Cleared in the PSE by a poll of the bring-up */
+	ctx->ports[port].status.latched_faults |= ctx->ports[port].unreported_faults;
+	ctx->ports[port].status.faults |= ctx->ports[port].unreported_faults;
+	ctx->ports[port].unreported_faults = 0;
+
+	/* Kept while the port is switched off, e.g. for ordering the bring-up */
+	if (ctx->ports[port].status.poe_class >= 0)
+		ctx->ports[port].last_poe_class = ctx->ports[port].status.poe_class;
+
+	ctx->ports[port].status.last_update = time(NULL);
+	return 0;
+}
+
+int poemgr_update_pse_status(struct poemgr_ctx *ctx)
+{
+	struct poemgr_pse_status *pse_status;
+	struct poemgr_pse_chip *pse_chip;
+	time_t now = time(NULL);
+	int ret;
 
 	/* Update input status */
-	ret = ctx->profile->update_input_status(ctx);
+	ret = poemgr_profile_cb(ctx, update_input_status)(ctx);
 	if (ret)
 		return ret;
 
+	ctx->input_status.last_update = now;
+
 	/* Update output status */
-	ret = ctx->profile->update_output_status(ctx);
+	ret = poemgr_profile_cb(ctx, update_output_status)(ctx);
 	if (ret)
 		return ret;
 
+	ctx->output_status.last_update = now;
+
+	/* Update PSE metrics */
+	for (int i = 0; i < ctx->profile->num_pse_chips; i++) {
+		pse_chip = &ctx->profile->pse_chips[i];
+		pse_status = &ctx->pse_status[i];
+
+		pse_status->num_metrics = 0;
+		for (int j = 0; j < pse_chip->num_metrics && j < POEMGR_MAX_METRICS; j++) {
+			ret = poemgr_pse_ops(pse_chip)->export_metric(pse_chip, &pse_status->metrics[j], j);
+			if (ret) {
+				fprintf(stderr, "Error exporting metrics from chip\n");
+				return ret;
+			}
+			pse_status->num_metrics++;
+		}
+
+		pse_status->last_update = now;
+	}
+
+	return 0;
+}
+
+int poemgr_update_status(struct poemgr_ctx *ctx)
+{
+	int ret;
+
+	/* Update port status */
+	for (int p_idx = 0; p_idx < poemgr_profile_num_ports(ctx); p_idx++) {
+		ret = poemgr_update_port_status(ctx, p_idx);
+		if (ret)
+			return ret;
+	}
+
+	return poemgr_update_pse_status(ctx);
+}
+
+struct json_object *poemgr_port_status_to_json(struct poemgr_ctx *ctx, int port)
+{
+	struct poemgr_port *p = &ctx->ports[port];
+	struct json_object *port_obj;
+
+	port_obj = json_object_new_object();
+	json_object_object_add(port_obj, "enabled", json_object_new_boolean(!!p->status.enabled));
+	json_object_object_add(port_obj, "active", json_object_new_boolean(!!p->status.active));
+	json_object_object_add(port_obj, "poe_class", json_object_new_int(p->status.poe_class));
+	json_object_object_add(port_obj, "power", json_object_new_int(p->status.power));
+	json_object_object_add(port_obj, "power_limit", json_object_new_int(p->status.power_limit));
+	json_object_object_add(port_obj, "name", !!p->settings.name ? json_object_new_string(p->settings.name) : NULL);
+	json_object_object_add(port_obj, "faults", poemgr_create_port_fault_array(p->status.faults));
+	if (p->status.time_to_power > 0)
+		json_object_object_add(port_obj, "time_to_power", json_object_new_int(p->status.time_to_power));
+	/* ToDo: Export PSE specific data */
+
+	return port_obj;
+}
+
+struct json_object *poemgr_status_to_json(struct poemgr_ctx *ctx)
+{
+	struct json_object *root_obj, *ports_obj, *port_obj, *pse_arr, *pse_obj, *input_obj, *output_obj, *thermal_obj;
+	struct poemgr_pse_status *pse_status;
+	struct poemgr_metric *metric;
+	char port_idx[12];
+
 	/* Create JSON object */
 	root_obj = json_object_new_object();
 
@@ -183,81 +379,126 @@ int poemgr_show(struct poemgr_ctx *ctx)
 
 	/* Get port information */
 	ports_obj = json_object_new_object();
-	for (int i = 0; i < ctx->profile->num_ports; i++) {
-		snprintf(port_idx, 3, "%d", i);
-		port_obj = json_object_new_object();
-		json_object_object_add(port_obj, "enabled", json_object_new_boolean(!!ctx->ports[i].status.enabled));
-		json_object_object_add(port_obj, "active", json_object_new_boolean(!!ctx->ports[i].status.active));
-		json_object_object_add(port_obj, "poe_class", json_object_new_int(ctx->ports[i].status.poe_class));
-		json_object_object_add(port_obj, "power", json_object_new_int(ctx->ports[i].status.power));
-		json_object_object_add(port_obj, "power_limit", json_object_new_int(ctx->ports[i].status.power_limit));
-		json_object_object_add(port_obj, "name", !!ctx->ports[i].settings.name ? json_object_new_string(ctx->ports[i].settings.name) : NULL);
-		json_object_object_add(port_obj, "faults", poemgr_create_port_fault_array(ctx->ports[i].status.faults));
-		/* ToDo: Export PSE specific data */
-
+	for (int i = 0; i < poemgr_profile_num_ports(ctx); i++) {
+		snprintf(port_idx, sizeof(port_idx), "%d", i);
+		port_obj = poemgr_port_status_to_json(ctx, i);
 		json_object_object_add(ports_obj, port_idx, port_obj);
 	}
 	json_object_object_add(output_obj, "ports", ports_obj);
 
 	json_object_object_add(root_obj, "output", output_obj);
 
+	/* Only tracked by the daemon */
+	if (ctx->thermal.valid) {
+		thermal_obj = json_object_new_object();
+		json_object_object_add(thermal_obj, "level", json_object_new_string(poemgr_thermal_level_to_string(ctx->thermal.level)));
+		json_object_object_add(thermal_obj, "temperature", json_object_new_int(ctx->thermal.temperature / 1000));
+		json_object_object_add(root_obj, "thermal", thermal_obj);
+	}
+
 	pse_arr = json_object_new_array();
 	json_object_object_add(root_obj, "pse", pse_arr);
 	for (int i = 0; i < ctx->profile->num_pse_chips; i++) {
-		pse_chip = &ctx->profile->pse_chips[i];
+		pse_status = &ctx->pse_status[i];
 		pse_obj = json_object_new_object();
 		json_object_array_add(pse_arr, pse_obj);
 
-		json_object_object_add(pse_obj, "model", json_object_new_string(pse_chip->model));
+		json_object_object_add(pse_obj, "model", json_object_new_string(ctx->profile->pse_chips[i].model));
 
-		for (int j = 0; j < pse_chip->num_metrics; j++) {
-			ret = pse_chip->export_metric(pse_chip, &metric_buf, j);
-			if (ret) {
-				fprintf(stderr, "Error exporting metrics from chip\n");
-				goto out;
-			}
+		for (int j = 0; j < pse_status->num_metrics; j++) {
+			metric = &pse_status->metrics[j];
 
-			/* ToDo handle memory in case of error */
-			switch (metric_buf.type) {
+			switch (metric->type) {
 				case POEMGR_METRIC_INT32:
-					json_object_object_add(pse_obj, metric_buf.name, json_object_new_int(metric_buf.val_int32));
+					json_object_object_add(pse_obj, metric->name, json_object_new_int(metric->val_int32));
 					break;
 				default:
-					ret = 1;
-					goto out;
+					break;
 			}
 		}
 	}
-	
+
+	return root_obj;
+}
+
+int poemgr_show(struct poemgr_ctx *ctx)
+{
+	struct json_object *root_obj;
+	int64_t span;
+	int ret = 0;
+
+	if(!poemgr_profile_cb(ctx, ready)(ctx)) {
+		fprintf(stderr, "Profile disabled. Enable profile first.\n");
+		return 1;
+	}
+
+	span = poemgr_trace_begin();
+	ret = poemgr_update_status(ctx);
+	poemgr_trace_end(span, "poemgr", "update status", 1, "result", ret);
+	if (ret) {
+		fprintf(stderr, "Error reading status from PSE\n");
+		return ret;
+	}
+
+	span = poemgr_trace_begin();
+	root_obj = poemgr_status_to_json(ctx);
 
 	/* Save to char pointer */
 	const char *c = json_object_to_json_string_ext(root_obj, JSON_C_TO_STRING_PRETTY);
+	poemgr_trace_end(span, "poemgr", "json build", 0);
 
+	span = poemgr_trace_begin();
 	fprintf(stdout, "%s\n", c);
+	fflush(stdout);
+	poemgr_trace_end(span, "poemgr", "output", 0);
 
-out:
 	json_object_put(root_obj);
 	return ret;
 }
 
 int poemgr_enable(struct poemgr_ctx *ctx)
 {
-	if (!ctx->profile->enable)
+	if (!poemgr_profile_has_cb(ctx, enable))
 		return 0;
 
-	return ctx->profile->enable(ctx);
+	return poemgr_profile_cb(ctx, enable)(ctx);
 }
 
 int poemgr_disable(struct poemgr_ctx *ctx)
 {
-	if (!ctx->profile->disable)
+	if (!poemgr_profile_has_cb(ctx, disable))
 		return 0;
 
-	return ctx->profile->disable(ctx);
+	return poemgr_profile_cb(ctx, disable)(ctx);
 }
 
-int poemgr_apply(struct poemgr_ctx *ctx)
+int poemgr_apply_config(struct poemgr_ctx *ctx)
 {
+	uint32_t pending;
+	int64_t span;
+	int ret;
+
+	if (!poemgr_profile_has_cb(ctx, apply_config))
+		return 0;
+
+	/* Ports not powered yet are switched on one after the other */
+	pending = poemgr_bringup_pending(ctx);
+
+	span = poemgr_trace_begin();
+	ctx->bringup_hold = pending;
+	ret = poemgr_profile_cb(ctx, apply_config)(ctx);
+	ctx->bringup_hold = 0;
+	poemgr_trace_end(span, "poemgr", "apply config", 1, "result", ret);
+	if (ret)
+		return ret;
+
+	return poemgr_bringup_start(ctx, pending);
+}
+
+int poemgr_apply_start(struct poemgr_ctx *ctx)
+{
+	int64_t span;
+
 	/* Implicitly enable profile. */
 	poemgr_enable(ctx);
 
@@ -267,76 +508,609 @@ int poemgr_apply(struct poemgr_ctx *ctx)
 	 * reports a 802.3af input, which results in a low-balled power budget.
 	 * After the following small nap, input is correctly read as 802.3at.
 	 */
+	span = poemgr_trace_begin();
 	usleep(10000);
+	poemgr_trace_end(span, "poemgr", "settle sleep", 0);
 
-	if (!ctx->profile->apply_config)
-		return 0;
-	
-	return ctx->profile->apply_config(ctx);
+	return poemgr_apply_config(ctx);
 }
 
-int main(int argc, char *argv[])
+int poemgr_apply(struct poemgr_ctx *ctx)
 {
-	struct uci_context *uci_ctx = uci_alloc_context();
-	static struct poemgr_profile *profile = NULL;
-	struct poemgr_ctx ctx = {};
-	char *action;
-	size_t i;
+	int64_t span;
 	int ret;
 
-	/* Default action */
-	action = POEMGR_ACTION_STRING_SHOW;
-
-	/* Load settings */
-	ret = poemgr_load_settings(&ctx, uci_ctx);
+	ret = poemgr_apply_start(ctx);
 	if (ret)
-		exit(1);
+		return ret;
 
-	/* Select profile */
-	for (i = 0; poemgr_profiles[i]; i++) {
-		profile = poemgr_profiles[i];
+	span = poemgr_trace_begin();
+	ret = poemgr_bringup_wait(ctx);
+	poemgr_trace_end(span, "poemgr", "bringup", 1, "result", ret);
+
+	return ret;
+}
+
+static int poemgr_cycle_output(struct poemgr_ctx *ctx, uint32_t portmask, uint32_t powered,
+			       int64_t *time_to_power)
+{
+	struct json_object *root_obj, *port_obj;
+	char port_idx[12];
+
+	root_obj = json_object_new_object();
+
+	for (int i = 0; i < poemgr_profile_num_ports(ctx); i++) {
+		if (!(portmask & (1 << i)))
+			continue;
+
+		port_obj = json_object_new_object();
+		json_object_object_add(port_obj, "name", json_object_new_string(ctx->ports[i].settings.name));
+		json_object_object_add(port_obj, "powered", json_object_new_boolean(!!(powered & (1 << i))));
+		if (powered & (1 << i))
+			json_object_object_add(port_obj, "time_to_power", json_object_new_int64(time_to_power[i]));
+
+		snprintf(port_idx, sizeof(port_idx), "%d", i);
+		json_object_object_add(root_obj, port_idx, port_obj);
+	}
+
+	fprintf(stdout, "%s\n", json_object_to_json_string_ext(root_obj, JSON_C_TO_STRING_PRETTY));
+	fflush(stdout);
+
+	json_object_put(root_obj);
+	return 0;
+}
+
+/**
+ * Power-cycle all ports in portmask together. With a timeout, wait for the
+ * ports to signal power-good and report their time-to-power (milliseconds).
+ */
+int poemgr_cycle(struct poemgr_ctx *ctx, uint32_t portmask, int off_time, int timeout)
+{
+	int64_t time_to_power[POEMGR_MAX_PORTS];
+	int64_t span, on, now;
+	uint32_t powered = 0;
+	int ret;
 
-		if (!strcmp(profile->name, ctx.settings.profile))
+	if (!poemgr_profile_has_cb(ctx, set_ports_power) || !poemgr_profile_has_cb(ctx, get_ports_power_good)) {
+		fprintf(stderr, "Profile does not support power-cycling ports.\n");
+		return 1;
+	}
+
+	if (!poemgr_profile_cb(ctx, ready)(ctx)) {
+		fprintf(stderr, "Profile disabled. Enable profile first.\n");
+		return 1;
+	}
+
+	span = poemgr_trace_begin();
+	ret = poemgr_profile_cb(ctx, set_ports_power)(ctx, portmask, 0);
+	poemgr_trace_end(span, "poemgr", "ports off", 1, "result", ret);
+	if (ret) {
+		fprintf(stderr, "Error switching off ports\n");
+		return 1;
+	}
+
+	span = poemgr_trace_begin();
+	usleep(off_time * 1000);
+	poemgr_trace_end(span, "poemgr", "off time", 0);
+
+	span = poemgr_trace_begin();
+	ret = poemgr_profile_cb(ctx, set_ports_power)(ctx, portmask, 1);
+	poemgr_trace_end(span, "poemgr", "ports on", 1, "result", ret);
+	if (ret) {
+		fprintf(stderr, "Error switching on ports\n");
+		return 1;
+	}
+
+	on = poemgr_time_ms();
+
+	if (timeout <= 0)
+		return 0;
+
+	span = poemgr_trace_begin();
+	while (1) {
+		ret = poemgr_profile_cb(ctx, get_ports_power_good)(ctx);
+		now = poemgr_time_ms();
+		if (ret < 0)
 			break;
+
+		for (int i = 0; i < poemgr_profile_num_ports(ctx); i++) {
+			if ((portmask & ~powered & ret) & (1 << i))
+				time_to_power[i] = now - on;
+		}
+		powered |= portmask & ret;
+
+		if (powered == portmask || now - on >= timeout)
+			break;
+
+		usleep(POEMGR_CYCLE_POLL_INTERVAL * 1000);
 	}
+	poemgr_trace_end(span, "poemgr", "wait power good", 1, "powered", powered);
 
-	if (profile == NULL)
-		exit(1);
+	if (ret < 0) {
+		fprintf(stderr, "Error reading power-good state from PSE\n");
+		return 1;
+	}
 
-	ctx.profile = profile;
+	poemgr_cycle_output(ctx, portmask, powered, time_to_power);
 
-	/* Load port settings (requires selected profile) */
-	ret = poemgr_load_port_settings(&ctx, uci_ctx);
+	return powered == portmask ? 0 : 1;
+}
+
+static int poemgr_profile_init(struct poemgr_ctx *ctx)
+{
+	int64_t span;
+	int ret;
+
+	span = poemgr_trace_begin();
+	ret = poemgr_profile_cb(ctx, init)(ctx);
+	poemgr_trace_end(span, "poemgr", "profile init", 1, "result", ret);
+
+	ctx->profile_initialized = !ret;
+	return ret;
+}
+
+/* Only shuts down a profile once, and only after a successful init */
+void poemgr_profile_end(struct poemgr_ctx *ctx)
+{
+	if (!ctx->profile_initialized)
+		return;
+
+	ctx->profile_initialized = 0;
+
+	if (poemgr_profile_has_cb(ctx, end))
+		poemgr_profile_cb(ctx, end)(ctx);
+}
+
+int poemgr_reload(struct poemgr_ctx *ctx)
+{
+	int ret;
+
+	/* Shut down the previous generation, its memory is released at once */
+	poemgr_profile_end(ctx);
+
+	poemgr_reset_settings(ctx);
+
+	ret = poemgr_load_config(ctx);
 	if (ret)
-		exit(1);
-
-	/* Call profile init routine */
-	if (profile->init(&ctx))
-		exit(1);
-
-	/* check which action we are supposed to perform */
-	if (argc > 1)
-		action = argv[1];
-	
-	if (!strcmp(POEMGR_ACTION_STRING_SHOW, action)) {
-		/* Show */
-		ret = poemgr_show(&ctx);
-	} else if (!strcmp(POEMGR_ACTION_STRING_APPLY, action)) {
-		/* Apply */
-		ret = poemgr_apply(&ctx);
-	} else if (!strcmp(POEMGR_ACTION_STRING_ENABLE, action)) {
-		/* Enable */
-		ret = poemgr_enable(&ctx);
-	} else if (!strcmp(POEMGR_ACTION_STRING_DISABLE, action)) {
-		/* Disable */
-		ret = poemgr_disable(&ctx);
-	} else {
+		return ret;
+
+	return poemgr_profile_init(ctx);
+}
+
+static int poemgr_action_show(struct poemgr_ctx *ctx, int argc, char *argv[])
+{
+	return poemgr_show(ctx);
+}
+
+static int poemgr_action_apply(struct poemgr_ctx *ctx, int argc, char *argv[])
+{
+	return poemgr_apply(ctx);
+}
+
+static int poemgr_action_enable(struct poemgr_ctx *ctx, int argc, char *argv[])
+{
+	return poemgr_enable(ctx);
+}
+
+static int poemgr_action_disable(struct poemgr_ctx *ctx, int argc, char *argv[])
+{
+	return poemgr_disable(ctx);
+}
+
+static int poemgr_action_reload(struct poemgr_ctx *ctx, int argc, char *argv[])
+{
+	return poemgr_reload(ctx);
+}
+
+static int poemgr_action_daemon(struct poemgr_ctx *ctx, int argc, char *argv[])
+{
+	const char *ubus_path = NULL, *agentx_path = NULL;
+
+	for (int i = 0; i < argc; i++) {
+		if (!strncmp(argv[i], "--agentx=", 9)) {
+			agentx_path = argv[i] + 9;
+			continue;
+		}
+
+		/* Optional: ubus socket path */
+		ubus_path = argv[i];
+	}
+
+	return poemgr_daemon(ctx, ubus_path, agentx_path);
+}
+
+/* Port index by configured name or number, -1 if unknown */
+static int poemgr_port_lookup(struct poemgr_ctx *ctx, const char *s)
+{
+	char *end;
+	long port;
+
+	for (int i = 0; i < poemgr_profile_num_ports(ctx); i++) {
+		if (ctx->ports[i].settings.name && !strcmp(ctx->ports[i].settings.name, s))
+			return i;
+	}
+
+	port = strtol(s, &end, 10);
+	if (*s == '\0' || *end != '\0' || port < 0 || port >= poemgr_profile_num_ports(ctx))
+		return -1;
+
+	return port;
+}
+
+/* Milliseconds, -1 if not a non-negative number */
+static int poemgr_parse_ms(const char *s)
+{
+	char *end;
+	long val;
+
+	errno = 0;
+	val = strtol(s, &end, 10);
+	if (*s == '\0' || *end != '\0' || errno || val < 0 || val > INT_MAX / 1000)
+		return -1;
+
+	return val;
+}
+
+static int poemgr_action_cycle(struct poemgr_ctx *ctx, int argc, char *argv[])
+{
+	int off_time = POEMGR_CYCLE_OFF_TIME;
+	struct poemgr_port_settings *settings;
+	uint32_t portmask = 0;
+	int timeout = 0;
+	int port;
+
+	for (int i = 0; i < argc; i++) {
+		if (!strncmp(argv[i], "--off-time=", 11)) {
+			off_time = poemgr_parse_ms(argv[i] + 11);
+			if (off_time < 0)
+				goto usage;
+			continue;
+		} else if (!strncmp(argv[i], "--wait=", 7)) {
+			timeout = poemgr_parse_ms(argv[i] + 7);
+			if (timeout < 0)
+				goto usage;
+			continue;
+		}
+
+		port = poemgr_port_lookup(ctx, argv[i]);
+		if (port < 0) {
+			fprintf(stderr, "Unknown port %s\n", argv[i]);
+			return 1;
+		}
+
+		/* Don't power ports which are switched off by configuration */
+		settings = &ctx->ports[port].settings;
+		if (!settings->name || settings->disabled || poemgr_thermal_port_shed(ctx, port)) {
+			fprintf(stderr, "Port %s is disabled\n", argv[i]);
+			return 1;
+		}
+
+		portmask |= 1 << port;
+	}
+
+	if (!portmask)
+		goto usage;
+
+	return poemgr_cycle(ctx, portmask, off_time, timeout);
+
+usage:
+	fprintf(stderr, "Usage: cycle [--off-time=<ms>] [--wait=<ms>] <port>...\n");
+	return 1;
+}
+
+static struct json_object *poemgr_journal_record_to_json(struct poemgr_ctx *ctx, struct poemgr_journal_record *rec)
+{
+	struct json_object *rec_obj;
+	time_t sec = rec->time_ms / 1000;
+	char time_str[40];
+	size_t len;
+	struct tm tm;
+
+	len = strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%S", localtime_r(&sec, &tm));
+	snprintf(time_str + len, sizeof(time_str) - len, ".%03d", (int) (rec->time_ms % 1000));
+
+	rec_obj = json_object_new_object();
+	json_object_object_add(rec_obj, "time", json_object_new_string(time_str));
+
+	if (rec->port == POEMGR_JOURNAL_PORT_NONE) {
+		json_object_object_add(rec_obj, "event", json_object_new_string("input"));
+		json_object_object_add(rec_obj, "input", json_object_new_string(poemgr_poe_type_to_string(rec->input_type)));
+		return rec_obj;
+	}
+
+	if (rec->active != rec->old_active)
+		json_object_object_add(rec_obj, "event", json_object_new_string(rec->active ? "up" : "down"));
+	else
+		json_object_object_add(rec_obj, "event", json_object_new_string("fault"));
+
+	json_object_object_add(rec_obj, "port", json_object_new_int(rec->port));
+	if (rec->port < poemgr_profile_num_ports(ctx) && ctx->ports[rec->port].settings.name)
+		json_object_object_add(rec_obj, "name", json_object_new_string(ctx->ports[rec->port].settings.name));
+	json_object_object_add(rec_obj, "active", json_object_new_boolean(rec->active));
+	json_object_object_add(rec_obj, "poe_class", json_object_new_int(rec->poe_class));
+	json_object_object_add(rec_obj, "faults", poemgr_create_port_fault_array(rec->faults));
+	json_object_object_add(rec_obj, "input", json_object_new_string(poemgr_poe_type_to_string(rec->input_type)));
+
+	return rec_obj;
+}
+
+static int poemgr_action_log(struct poemgr_ctx *ctx, int argc, char *argv[])
+{
+	struct poemgr_journal_record *records;
+	struct json_object *arr;
+	size_t num_records;
+	int64_t since = 0;
+	int port = -1;
+	char *end;
+
+	for (int i = 0; i < argc; i++) {
+		if (!strncmp(argv[i], "--since=", 8)) {
+			/* UNIX time, or seconds before now when negative */
+			since = strtoll(argv[i] + 8, &end, 10);
+			if (argv[i][8] == '\0' || *end != '\0')
+				goto usage;
+			if (since < 0)
+				since += time(NULL);
+			continue;
+		} else if (!strncmp(argv[i], "--port=", 7)) {
+			port = poemgr_port_lookup(ctx, argv[i] + 7);
+			if (port < 0) {
+				fprintf(stderr, "Unknown port %s\n", argv[i] + 7);
+				return 1;
+			}
+			continue;
+		}
+
+		goto usage;
+	}
+
+	if (poemgr_journal_read(POEMGR_JOURNAL_FILE, &records, &num_records))
+		return 1;
+
+	arr = json_object_new_array();
+	for (size_t i = 0; i < num_records; i++) {
+		if (records[i].time_ms < since * 1000)
+			continue;
+		if (port >= 0 && records[i].port != port)
+			continue;
+
+		json_object_array_add(arr, poemgr_journal_record_to_json(ctx, &records[i]));
+	}
+
+	fprintf(stdout, "%s\n", json_object_to_json_string_ext(arr, JSON_C_TO_STRING_PRETTY));
+	fflush(stdout);
+
+	json_object_put(arr);
+	free(records);
+	return 0;
+
+usage:
+	fprintf(stderr, "Usage: log [--since=<time>] [--port=<port>]\n");
+	return 1;
+}
+
+struct poemgr_action {
+	const char *name;
+	int (*handler)(struct poemgr_ctx *ctx, int argc, char *argv[]);
+	/* Accesses the PSE, the profile is initialized before the first such action */
+	int pse;
+};
+
+static const struct poemgr_action poemgr_actions[] = {
+	{ POEMGR_ACTION_STRING_SHOW, &poemgr_action_show, 1 },
+	{ POEMGR_ACTION_STRING_APPLY, &poemgr_action_apply, 1 },
+	{ POEMGR_ACTION_STRING_ENABLE, &poemgr_action_enable, 1 },
+	{ POEMGR_ACTION_STRING_DISABLE, &poemgr_action_disable, 1 },
+	/* Initializes the profile by itself */
+	{ POEMGR_ACTION_STRING_RELOAD, &poemgr_action_reload, 0 },
+	{ POEMGR_ACTION_STRING_DAEMON, &poemgr_action_daemon, 1 },
+	{ POEMGR_ACTION_STRING_CYCLE, &poemgr_action_cycle, 1 },
+	{ POEMGR_ACTION_STRING_LOG, &poemgr_action_log, 0 },
+	{ NULL, NULL, 0 },
+};
+
+static const struct poemgr_action *poemgr_action_get(const char *name)
+{
+	for (int i = 0; poemgr_actions[i].name; i++) {
+		if (!strcmp(poemgr_actions[i].name, name))
+			return &poemgr_actions[i];
+	}
+
+	return NULL;
+}
+
+/* argv[0] is the action, followed by its arguments */
+static int poemgr_run_action(struct poemgr_ctx *ctx, int argc, char *argv[], int report)
+{
+	const struct poemgr_action *action = poemgr_action_get(argv[0]);
+	int64_t span;
+	int ret;
+
+	if (!action) {
 		fprintf(stderr, "Unknown command.\n");
 		ret = 1;
+	} else if (action->pse && !ctx->profile_initialized && poemgr_profile_init(ctx)) {
+		fprintf(stderr, "Error initializing profile %s\n", ctx->profile->name);
+		ret = 1;
+	} else {
+		span = poemgr_trace_begin();
+		ret = action->handler(ctx, argc - 1, argv + 1);
+		poemgr_trace_end(span, "action", action->name, 1, "result", ret);
 	}
-	
-	if (uci_ctx)
-		uci_free_context(uci_ctx);
+
+	if (report) {
+		if (ret)
+			fprintf(stderr, "%s: failed (%d)\n", argv[0], ret);
+		else
+			fprintf(stderr, "%s: ok\n", argv[0]);
+	}
+
+	return ret;
+}
+
+/**
+ * Run a sequence of actions given on the command line. Every known action
+ * name starts a new action, other words are arguments of the preceding one.
+ * Execution stops at the first failing action.
+ */
+static int poemgr_run_batch(struct poemgr_ctx *ctx, int argc, char *argv[])
+{
+	int report = argc > 1;
+	int start, i = 0;
+	int ret = 0;
+
+	while (i < argc) {
+		start = i++;
+		while (i < argc && !poemgr_action_get(argv[i]))
+			i++;
+
+		if (ret) {
+			if (report)
+				fprintf(stderr, "%s: skipped\n", argv[start]);
+			continue;
+		}
+
+		ret = poemgr_run_action(ctx, i - start, &argv[start], report);
+	}
+
+	return ret;
+}
+
+/**
+ * Run actions read from a script, one action with its arguments per line.
+ * Empty lines and lines starting with '#' are ignored.
+ */
+static int poemgr_run_script(struct poemgr_ctx *ctx, FILE *f)
+{
+	char *argv[POEMGR_SCRIPT_MAX_ARGS];
+	char *line = NULL;
+	size_t line_len = 0;
+	char *tok;
+	int ret = 0;
+	int argc;
+
+	while (getline(&line, &line_len, f) >= 0) {
+		argc = 0;
+		for (tok = strtok(line, " \t\r\n"); tok && argc < POEMGR_SCRIPT_MAX_ARGS; tok = strtok(NULL, " \t\r\n"))
+			argv[argc++] = tok;
+
+		if (!argc || argv[0][0] == '#')
+			continue;
+
+		if (ret) {
+			fprintf(stderr, "%s: skipped\n", argv[0]);
+			continue;
+		}
+
+		ret = poemgr_run_action(ctx, argc, argv, 1);
+		fflush(stdout);
+	}
+
+	free(line);
+	return ret;
+}
+
+static void poemgr_usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [--trace=<file>] [--record=<file> | --replay=<file> [--replay-speed=<factor>]]\n"
+			"          [--simulate] [action [args...]]... | -\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{ "trace", required_argument, NULL, 't' },
+		{ "record", required_argument, NULL, 'r' },
+		{ "replay", required_argument, NULL, 'p' },
+		{ "replay-speed", required_argument, NULL, 's' },
+		{ "simulate", no_argument, NULL, 'S' },
+		{ NULL, 0, NULL, 0 },
+	};
+	struct poemgr_ctx ctx = {};
+	char *default_action[] = { POEMGR_ACTION_STRING_SHOW };
+	const char *record = NULL, *replay = NULL;
+	double replay_speed = 1.0;
+	char *end;
+	int ret;
+	int c;
+
+	/* Stop at the first action, so action arguments are not parsed as options */
+	while ((c = getopt_long(argc, argv, "+", long_options, NULL)) != -1) {
+		switch (c) {
+			case 't':
+				if (poemgr_trace_open(optarg)) {
+					fprintf(stderr, "Error allocating trace buffer\n");
+					return 1;
+				}
+				break;
+			case 'r':
+				record = optarg;
+				break;
+			case 'p':
+				replay = optarg;
+				break;
+			case 's':
+				replay_speed = strtod(optarg, &end);
+				if (*end || replay_speed < 0) {
+					poemgr_usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'S':
+				poemgr_smbus_simulate = 1;
+				break;
+			default:
+				poemgr_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (record && replay) {
+		poemgr_usage(argv[0]);
+		return 1;
+	}
+
+	if (record && poemgr_capture_record_open(record))
+		return 1;
+
+	if (replay && poemgr_capture_replay_open(replay, replay_speed))
+		return 1;
+
+	argc -= optind;
+	argv += optind;
+
+	for (int i = 0; i < POEMGR_MAX_PORTS; i++)
+		ctx.ports[i].last_poe_class = -1;
+
+	ret = 1;
+
+	/* Load settings */
+	if (poemgr_load_config(&ctx))
+		goto out;
+
+	/* check which actions we are supposed to perform, the first one accessing the PSE initializes the profile */
+	if (argc == 1 && !strcmp(argv[0], "-"))
+		ret = poemgr_run_script(&ctx, stdin);
+	else if (argc > 0)
+		ret = poemgr_run_batch(&ctx, argc, argv);
+	else
+		ret = poemgr_run_batch(&ctx, 1, default_action);
+
+	/* Not initialized without PSE access, or after a failed reload */
+	poemgr_profile_end(&ctx);
+
+out:
+	poemgr_cache_release(&ctx);
+	poemgr_arena_free(&ctx.arena);
+
+	if (ctx.uci_ctx)
+		uci_free_context(ctx.uci_ctx);
+
+	if (poemgr_capture_close())
+		fprintf(stderr, "Error writing capture\n");
+
+	if (poemgr_trace_close())
+		fprintf(stderr, "Error writing trace\n");
 
 	return ret;
 }
@@ -5,6 +5,8 @@
 #include <time.h>
 #include <stdint.h>
 
+#include "arena.h"
+
 #define POEMGR_MAX_PORTS	4
 #define POEMGR_MAX_PSE_CHIPS	2
 
@@ -14,6 +16,16 @@
 #define POEMGR_ACTION_STRING_DISABLE	"disable"
 #define POEMGR_ACTION_STRING_SHOW		"show"
 #define POEMGR_ACTION_STRING_APPLY		"apply"
+#define POEMGR_ACTION_STRING_DAEMON		"daemon"
+#define POEMGR_ACTION_STRING_RELOAD		"reload"
+#define POEMGR_ACTION_STRING_CYCLE		"cycle"
+#define POEMGR_ACTION_STRING_LOG		"log"
+
+#define POEMGR_SCRIPT_MAX_ARGS		16
+
+/* Port power-cycling (milliseconds) */
+#define POEMGR_CYCLE_OFF_TIME		1000
+#define POEMGR_CYCLE_POLL_INTERVAL	20
 
 enum poemgr_poe_type {
 	POEMGR_POE_TYPE_AF = 0x1,
@@ -33,14 +45,42 @@ enum poemgr_port_fault_type {
 	POEMGR_FAULT_TYPE_UNKNOWN = 0x100,
 };
 
+/* Iterate over the fault bits in the order they are reported */
+#define poemgr_for_each_port_fault(fault) \
+	for (fault = POEMGR_FAULT_TYPE_POWER_MANAGEMENT; fault <= POEMGR_FAULT_TYPE_UNKNOWN; fault <<= 1)
+
+enum poemgr_port_priority {
+	POEMGR_PORT_PRIORITY_LOW,
+	POEMGR_PORT_PRIORITY_HIGH,
+	POEMGR_PORT_PRIORITY_CRITICAL,
+};
+
+enum poemgr_thermal_level {
+	POEMGR_THERMAL_LEVEL_NORMAL,
+	POEMGR_THERMAL_LEVEL_DERATE,
+	POEMGR_THERMAL_LEVEL_SHED,
+};
+
 enum poemgr_metric_type {
 	POEMGR_METRIC_INT32,
 };
 
+struct poemgr_metric {
+	enum poemgr_metric_type type;
+	char *name;
+	union {
+		char *val_char;
+		int32_t val_int32;
+	};
+};
+
 struct poemgr_port_settings {
 	char *name;
 	int disabled;
 	int pse_port;
+	enum poemgr_port_priority priority;
+	/* Priority configured, only ports explicitly set to low are shed */
+	int priority_set;
 };
 
 struct poemgr_port_status {
@@ -51,13 +91,31 @@ struct poemgr_port_status {
 	int poe_class;
 
 	int faults;
+	/* Faults latched by the PSE since the previous poll, included in faults */
+	int latched_faults;
+
+	/* Milliseconds until power-good during the last bring-up, 0 if not measured */
+	int time_to_power;
 
 	time_t last_update;
 };
 
+/* Refresh schedule of a status item polled by the daemon */
+struct poemgr_poll {
+	int64_t next_update;	/* Monotonic, milliseconds */
+	int interval;		/* Milliseconds */
+};
+
 struct poemgr_port {
 	struct poemgr_port_settings settings;
 	struct poemgr_port_status status;
+	struct poemgr_poll poll;
+
+	/* Class of the PD last seen on the port, -1 if unknown */
+	int last_poe_class;
+
+	/* Latched faults read by a poll whose status was discarded, reported by the next one */
+	int unreported_faults;
 };
 
 struct poemgr_input_status {
@@ -72,40 +130,111 @@ struct poemgr_output_status {
 	time_t last_update;
 };
 
+struct poemgr_pse_status {
+	struct poemgr_metric metrics[POEMGR_MAX_METRICS];
+	int num_metrics;
+
+	time_t last_update;
+};
+
 struct poemgr_settings {
 	int disabled;
 	int power_budget;
 	char *profile;
+
+	/* Daemon polling intervals (milliseconds) */
+	int poll_interval_min;
+	int poll_interval_max;
+	int poll_interval_pse;
+
+	/* Thermal derating (degrees Celsius, percent) */
+	int thermal_derate_temp;
+	int thermal_shed_temp;
+	int thermal_hysteresis;
+	int thermal_derate_limit;
+};
+
+/* Thermal derating state maintained by the daemon */
+struct poemgr_thermal {
+	enum poemgr_thermal_level level;
+
+	/* Smoothed temperature of the hottest chip (milli-degrees Celsius) */
+	int temperature;
+	int valid;
+};
+
+/* Staggered bring-up in progress, advanced by poemgr_bringup_run */
+struct poemgr_bringup {
+	int active;
+	int error;
+
+	/* Ports in bring-up order, the port being brought up is order[current] */
+	int order[POEMGR_MAX_PORTS];
+	int num_ports;
+	int current;
+
+	/* Class of the ports when the bring-up started, -1 if unknown */
+	int poe_class[POEMGR_MAX_PORTS];
+
+	uint32_t powered;
+	int budget;
+
+	/* Current port is switched on and waits for power-good, otherwise it waits for budget */
+	int switched_on;
+	int64_t start;
+	int last_consumption;
+
+	int64_t next_update;
+	int64_t span;
 };
 
+struct uci_context;
+struct poemgr_cache;
+
 struct poemgr_ctx {
+	/* Only allocated when the config cache is stale */
+	struct uci_context *uci_ctx;
+
+	/* Mapped config cache the settings were loaded from */
+	const struct poemgr_cache *cache;
+
+	/* Allocations of the current configuration generation */
+	struct poemgr_arena arena;
+
 	struct poemgr_settings settings;
 	struct poemgr_port ports[POEMGR_MAX_PORTS];
 	struct poemgr_profile *profile;
 
+	/* Profile init() succeeded, end() not called yet */
+	int profile_initialized;
+
 	struct poemgr_input_status input_status;
 	struct poemgr_output_status output_status;
-};
+	struct poemgr_pse_status pse_status[POEMGR_MAX_PSE_CHIPS];
+	struct poemgr_poll pse_poll;
 
-struct poemgr_metric {
-	enum poemgr_metric_type type;
-	char *name;
-	union {
-		char *val_char;
-		int32_t val_int32;
-	};
+	struct poemgr_thermal thermal;
+
+	/* Ports kept off by apply_config, switched on by the staggered bring-up */
+	uint32_t bringup_hold;
+	struct poemgr_bringup bringup;
 };
 
+struct poemgr_pse_ops;
+
 struct poemgr_pse_chip {
 	const char *model;
+	const struct poemgr_pse_ops *ops;
 
 	uint32_t portmask;
 
+	/* Power budget banks, selected by the chip depending on its inputs */
+	int num_budget_banks;
+
 	void *priv;
 
 	/* Metrics */
 	int num_metrics;
-	int (*export_metric)(struct poemgr_pse_chip *pse_chip, struct poemgr_metric *output, int metric);
 };
 
 struct poemgr_profile {
@@ -118,6 +247,7 @@ struct poemgr_profile {
 	void *priv;
 
 	int (*init)(struct poemgr_ctx *);
+	int (*end)(struct poemgr_ctx *);
 	int (*ready)(struct poemgr_ctx *);
 	int (*enable)(struct poemgr_ctx *);
 	int (*disable)(struct poemgr_ctx *);
@@ -125,8 +255,37 @@ struct poemgr_profile {
 	int (*update_port_status)(struct poemgr_ctx *, int port);
 	int (*update_input_status)(struct poemgr_ctx *);
 	int (*update_output_status)(struct poemgr_ctx *);
+
+	/* Switch power of all ports in portmask at once */
+	int (*set_ports_power)(struct poemgr_ctx *, uint32_t portmask, int enable);
+	/* Returns the bitmask of ports with power-good */
+	int (*get_ports_power_good)(struct poemgr_ctx *);
 };
 
+/**
+ * Profile callbacks. Single-profile builds (make PROFILE=<name>) call the
+ * callbacks of the selected profile directly instead of through the profile,
+ * so the compiler can inline them using a constant number of ports.
+ */
+#ifdef POEMGR_PROFILE
+#include POEMGR_PROFILE_HEADER
+
+#define __poemgr_profile_sym(profile, sym)	poemgr_##profile##_##sym
+#define _poemgr_profile_sym(profile, sym)	__poemgr_profile_sym(profile, sym)
+
+#define poemgr_profile_cb(ctx, cb)		_poemgr_profile_sym(POEMGR_PROFILE, cb)
+#define poemgr_profile_has_cb(ctx, cb)		1
+#define poemgr_profile_num_ports(ctx)		_poemgr_profile_sym(POEMGR_PROFILE, num_ports)
+
+#define POEMGR_PROFILE_EXPORT
+#else
+#define poemgr_profile_cb(ctx, cb)		((ctx)->profile->cb)
+#define poemgr_profile_has_cb(ctx, cb)		(!!(ctx)->profile->cb)
+#define poemgr_profile_num_ports(ctx)		((ctx)->profile->num_ports)
+
+#define POEMGR_PROFILE_EXPORT			static
+#endif
+
 static inline const char *poemgr_poe_type_to_string(enum poemgr_poe_type poe_type)
 {
 	if (poe_type == POEMGR_POE_TYPE_AF)
@@ -139,7 +298,60 @@ static inline const char *poemgr_poe_type_to_string(enum poemgr_poe_type poe_typ
 	return "unknown";
 }
 
+static inline const char *poemgr_port_fault_to_string(enum poemgr_port_fault_type fault)
+{
+	switch (fault) {
+		case POEMGR_FAULT_TYPE_POWER_MANAGEMENT:
+			return "power-budget-exceeded";
+		case POEMGR_FAULT_TYPE_OVER_TEMPERATURE:
+			return "over-temperature";
+		case POEMGR_FAULT_TYPE_SHORT_CIRCUIT:
+			return "short-circuit";
+		case POEMGR_FAULT_TYPE_RESISTANCE_TOO_LOW:
+			return "resistance-too-low";
+		case POEMGR_FAULT_TYPE_RESISTANCE_TOO_HIGH:
+			return "resistance-too-high";
+		case POEMGR_FAULT_TYPE_CAPACITY_TOO_HIGH:
+			return "capacity-too-high";
+		case POEMGR_FAULT_TYPE_OPEN_CIRCUIT:
+			return "open-circuit";
+		case POEMGR_FAULT_TYPE_OVER_CURRENT:
+			return "over-current";
+		default:
+			return "unknown";
+	}
+}
+
 static inline struct poemgr_pse_chip *poemgr_profile_pse_chip_get(struct poemgr_profile *profile, int pse_idx)
 {
 	return &profile->pse_chips[pse_idx];
-} 
+}
+
+int poemgr_update_port_status(struct poemgr_ctx *ctx, int port);
+
+int poemgr_update_pse_status(struct poemgr_ctx *ctx);
+
+int poemgr_update_status(struct poemgr_ctx *ctx);
+
+struct json_object *poemgr_port_status_to_json(struct poemgr_ctx *ctx, int port);
+
+struct json_object *poemgr_status_to_json(struct poemgr_ctx *ctx);
+
+int poemgr_enable(struct poemgr_ctx *ctx);
+
+int poemgr_disable(struct poemgr_ctx *ctx);
+
+int poemgr_apply(struct poemgr_ctx *ctx);
+
+/* Apply without waiting for the bring-up, which is left to poemgr_bringup_run */
+int poemgr_apply_start(struct poemgr_ctx *ctx);
+
+/* Write the port configuration to the PSE and start switching on unpowered ports one after the other */
+int poemgr_apply_config(struct poemgr_ctx *ctx);
+
+int poemgr_reload(struct poemgr_ctx *ctx);
+
+/* Shut down the profile, does nothing unless it was initialized */
+void poemgr_profile_end(struct poemgr_ctx *ctx);
+
+int poemgr_cycle(struct poemgr_ctx *ctx, uint32_t portmask, int off_time, int timeout);
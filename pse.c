@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include "poemgr.h"
+#include "pse.h"
+#include "thermal.h"
+
+int poemgr_pse_apply_config(struct poemgr_ctx *ctx, struct poemgr_pse_chip *pse_chip, int budget,
+			    const int *bank_budgets)
+{
+	const struct poemgr_pse_ops *ops = poemgr_pse_ops(pse_chip);
+	struct poemgr_port_settings *port_settings;
+	uint32_t auto_mask = 0;
+	int ret;
+
+	/* A bank maps to the state of the power-good inputs of the chip */
+	for (int i = 0; i < pse_chip->num_budget_banks; i++) {
+		ret = ops->set_budget(pse_chip, i, bank_budgets ? bank_budgets[i] : budget);
+		if (ret < 0)
+			return ret;
+	}
+
+	for (int i = 0; i < POEMGR_MAX_PORTS; i++) {
+		if (!(pse_chip->portmask & (1 << i)))
+			continue;
+
+		port_settings = &ctx->ports[i].settings;
+		if (!port_settings->name || port_settings->disabled || poemgr_thermal_port_shed(ctx, i) ||
+		    ctx->bringup_hold & (1 << i))
+			continue;
+
+		auto_mask |= 1 << i;
+	}
+
+	ret = ops->set_port_mode(pse_chip, pse_chip->portmask & ~auto_mask, POEMGR_PSE_PORT_MODE_OFF);
+	if (ret < 0)
+		return ret;
+
+	ret = ops->set_port_mode(pse_chip, auto_mask, POEMGR_PSE_PORT_MODE_AUTO);
+	if (ret < 0)
+		return ret;
+
+	for (int i = 0; i < POEMGR_MAX_PORTS; i++) {
+		if (!(pse_chip->portmask & (1 << i)))
+			continue;
+
+		/* Output limit per port, lowered while thermally derated */
+		ret = ops->set_limits(pse_chip, i, poemgr_thermal_port_power_limit(ctx, i, budget));
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
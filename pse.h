@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "poemgr.h"
+
+#define POEMGR_PSE_SNAPSHOT_REGS	0x100
+
+/* Register image of a PSE chip, filled by the snapshot op */
+struct poemgr_pse_snapshot {
+	uint8_t regs[POEMGR_PSE_SNAPSHOT_REGS];
+
+	/* Ports and chip-wide registers contained */
+	uint32_t portmask;
+	int chip;
+};
+
+enum poemgr_pse_port_mode {
+	POEMGR_PSE_PORT_MODE_OFF,
+	POEMGR_PSE_PORT_MODE_AUTO,
+};
+
+/**
+ * PSE chip driver. Ports are numbered by the PSE, power values are in watts.
+ * Operations return 0 on success and a negative value on error unless noted
+ * otherwise.
+ */
+struct poemgr_pse_ops {
+	int (*init)(struct poemgr_pse_chip *pse_chip, struct poemgr_arena *arena, int i2c_bus, int i2c_addr,
+		    uint32_t portmask);
+	int (*end)(struct poemgr_pse_chip *pse_chip);
+
+	/* Returns 1 if the chip is accessible */
+	int (*online)(struct poemgr_pse_chip *pse_chip);
+
+	/**
+	 * Read the status registers of the ports in portmask (and of the chip) in as few transfers as possible.
+	 * Reads the clear-on-read event registers as well, the driver keeps their faults until port_status
+	 * reported them as latched_faults.
+	 */
+	int (*snapshot)(struct poemgr_pse_chip *pse_chip, struct poemgr_pse_snapshot *snapshot,
+			uint32_t portmask, int chip);
+	void (*port_status)(struct poemgr_pse_chip *pse_chip, const struct poemgr_pse_snapshot *snapshot,
+			    int port, struct poemgr_port_status *status);
+
+	/* Switch the mode of all ports in portmask at once */
+	int (*set_port_mode)(struct poemgr_pse_chip *pse_chip, uint32_t portmask, enum poemgr_pse_port_mode mode);
+	/* Returns the bitmask of ports with power-good */
+	int (*get_power_good)(struct poemgr_pse_chip *pse_chip);
+
+	int (*set_limits)(struct poemgr_pse_chip *pse_chip, int port, int power_limit);
+	/* Budget of one of num_budget_banks banks, may be NULL without banks */
+	int (*set_budget)(struct poemgr_pse_chip *pse_chip, int bank, int budget);
+
+	int (*export_metric)(struct poemgr_pse_chip *pse_chip, struct poemgr_metric *output, int metric);
+};
+
+/**
+ * Ops of a chip. Single-profile builds of a profile with a single chip driver
+ * (POEMGR_PROFILE_PSE_OPS, set by the profile header) bind them at compile
+ * time instead of loading them from the chip, so the calls can be inlined.
+ */
+#ifdef POEMGR_PROFILE_PSE_OPS
+#define poemgr_pse_ops(pse_chip)		((void) (pse_chip), &POEMGR_PROFILE_PSE_OPS)
+#else
+#define poemgr_pse_ops(pse_chip)		((pse_chip)->ops)
+#endif
+
+/**
+ * Apply the port settings to a chip driving ports 0..n of the device.
+ * Writes bank_budgets (or budget to all banks if NULL) to the budget banks,
+ * switches the port modes with one write per mode and sets the (thermally
+ * derated) port power limits based on budget.
+ */
+int poemgr_pse_apply_config(struct poemgr_ctx *ctx, struct poemgr_pse_chip *pse_chip, int budget,
+			    const int *bank_budgets);
+
+static inline int poemgr_pse_update_port_status(struct poemgr_pse_chip *pse_chip, int port,
+						struct poemgr_port_status *status)
+{
+	struct poemgr_pse_snapshot snapshot;
+
+	if (poemgr_pse_ops(pse_chip)->snapshot(pse_chip, &snapshot, 1 << port, 0))
+		return 1;
+
+	poemgr_pse_ops(pse_chip)->port_status(pse_chip, &snapshot, port, status);
+
+	return 0;
+}
@@ -0,0 +1,192 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <string.h>
+#include <time.h>
+
+#include "scheduler.h"
+
+/**
+ * Every port is refreshed on its own schedule. A port whose status changed
+ * during the last refresh is polled again after the minimum interval, as it
+ * is likely going through detection / classification or carries a fault.
+ * Each refresh without a change doubles the interval up to the maximum, so
+ * stable powered as well as empty ports only cause little bus load.
+ *
+ * PSE-wide information (input type, power budget, metrics like VTEMP) is
+ * refreshed on a separate, fixed cadence.
+ */
+
+int64_t poemgr_time_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int poemgr_sched_interval_min(struct poemgr_ctx *ctx)
+{
+	if (ctx->settings.poll_interval_min > 0)
+		return ctx->settings.poll_interval_min;
+
+	return POEMGR_POLL_INTERVAL_MIN;
+}
+
+static int poemgr_sched_interval_max(struct poemgr_ctx *ctx)
+{
+	int interval_min = poemgr_sched_interval_min(ctx);
+
+	if (ctx->settings.poll_interval_max >= interval_min)
+		return ctx->settings.poll_interval_max;
+
+	if (POEMGR_POLL_INTERVAL_MAX < interval_min)
+		return interval_min;
+
+	return POEMGR_POLL_INTERVAL_MAX;
+}
+
+static int poemgr_sched_interval_pse(struct poemgr_ctx *ctx)
+{
+	if (ctx->settings.poll_interval_pse > 0)
+		return ctx->settings.poll_interval_pse;
+
+	return POEMGR_POLL_INTERVAL_PSE;
+}
+
+static int poemgr_port_status_changed(struct poemgr_port_status *old, struct poemgr_port_status *new)
+{
+	return old->enabled != new->enabled ||
+	       old->active != new->active ||
+	       old->poe_class != new->poe_class ||
+	       old->power_limit != new->power_limit ||
+	       old->faults != new->faults;
+}
+
+void poemgr_sched_init(struct poemgr_ctx *ctx, int64_t now)
+{
+	int interval_min = poemgr_sched_interval_min(ctx);
+
+	for (int i = 0; i < poemgr_profile_num_ports(ctx); i++) {
+		ctx->ports[i].poll.next_update = now;
+		ctx->ports[i].poll.interval = interval_min;
+	}
+
+	ctx->pse_poll.next_update = now;
+	ctx->pse_poll.interval = poemgr_sched_interval_pse(ctx);
+}
+
+void poemgr_sched_port_due(struct poemgr_ctx *ctx, int port, int64_t now)
+{
+	ctx->ports[port].poll.next_update = now;
+	ctx->ports[port].poll.interval = poemgr_sched_interval_min(ctx);
+}
+
+static int poemgr_sched_run_port(struct poemgr_ctx *ctx, int port, int64_t now, struct poemgr_sched_result *result)
+{
+	struct poemgr_port *p = &ctx->ports[port];
+	struct poemgr_port_status old_status;
+	int ret;
+
+	memcpy(&old_status, &p->status, sizeof(old_status));
+
+	ret = poemgr_update_port_status(ctx, port);
+	if (ret) {
+		/* Retry on the current schedule, don't hammer a failing bus */
+		p->poll.next_update = now + p->poll.interval;
+		return ret;
+	}
+
+	if (poemgr_port_status_changed(&old_status, &p->status)) {
+		result->changed_ports |= (1 << port);
+		result->old_port_status[port] = old_status;
+		p->poll.interval = poemgr_sched_interval_min(ctx);
+	} else if (p->poll.interval < poemgr_sched_interval_max(ctx)) {
+		p->poll.interval *= 2;
+		if (p->poll.interval > poemgr_sched_interval_max(ctx))
+			p->poll.interval = poemgr_sched_interval_max(ctx);
+	}
+
+	p->poll.next_update = now + p->poll.interval;
+
+	return 0;
+}
+
+static int poemgr_pse_status_changed(struct poemgr_pse_status *old, struct poemgr_pse_status *new)
+{
+	if (old->num_metrics != new->num_metrics)
+		return 1;
+
+	for (int i = 0; i < new->num_metrics; i++) {
+		if (old->metrics[i].type == POEMGR_METRIC_INT32 &&
+		    old->metrics[i].val_int32 != new->metrics[i].val_int32)
+			return 1;
+	}
+
+	return 0;
+}
+
+static int poemgr_sched_run_pse(struct poemgr_ctx *ctx, int64_t now, struct poemgr_sched_result *result)
+{
+	struct poemgr_input_status old_input = ctx->input_status;
+	struct poemgr_output_status old_output = ctx->output_status;
+	struct poemgr_pse_status old_pse[POEMGR_MAX_PSE_CHIPS];
+	int ret;
+
+	memcpy(old_pse, ctx->pse_status, sizeof(old_pse));
+
+	ctx->pse_poll.interval = poemgr_sched_interval_pse(ctx);
+	ctx->pse_poll.next_update = now + ctx->pse_poll.interval;
+
+	ret = poemgr_update_pse_status(ctx);
+	if (ret)
+		return ret;
+
+	result->pse_updated = 1;
+	result->old_input_status = old_input;
+
+	if (old_input.type != ctx->input_status.type ||
+	    old_output.power_budget != ctx->output_status.power_budget)
+		result->pse_changed = 1;
+
+	for (int i = 0; i < ctx->profile->num_pse_chips; i++) {
+		if (poemgr_pse_status_changed(&old_pse[i], &ctx->pse_status[i]))
+			result->pse_changed = 1;
+	}
+
+	return 0;
+}
+
+int poemgr_sched_run(struct poemgr_ctx *ctx, int64_t now, struct poemgr_sched_result *result)
+{
+	int ret = 0;
+
+	memset(result, 0, sizeof(*result));
+
+	for (int i = 0; i < poemgr_profile_num_ports(ctx); i++) {
+		if (ctx->ports[i].poll.next_update > now)
+			continue;
+
+		if (poemgr_sched_run_port(ctx, i, now, result))
+			ret = 1;
+	}
+
+	if (ctx->pse_poll.next_update <= now) {
+		if (poemgr_sched_run_pse(ctx, now, result))
+			ret = 1;
+	}
+
+	return ret;
+}
+
+int64_t poemgr_sched_next_update(struct poemgr_ctx *ctx)
+{
+	int64_t next_update = ctx->pse_poll.next_update;
+
+	for (int i = 0; i < poemgr_profile_num_ports(ctx); i++) {
+		if (ctx->ports[i].poll.next_update < next_update)
+			next_update = ctx->ports[i].poll.next_update;
+	}
+
+	return next_update;
+}
@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "poemgr.h"
+
+/* Default polling intervals (milliseconds) */
+#define POEMGR_POLL_INTERVAL_MIN	250
+#define POEMGR_POLL_INTERVAL_MAX	8000
+#define POEMGR_POLL_INTERVAL_PSE	5000
+
+struct poemgr_sched_result {
+	/* Ports whose status changed during this run */
+	uint32_t changed_ports;
+
+	/* PSE-wide status was refreshed */
+	int pse_updated;
+
+	/* Input type, power budget or PSE metrics changed */
+	int pse_changed;
+
+	/* Status prior to the refresh, valid for changed items */
+	struct poemgr_port_status old_port_status[POEMGR_MAX_PORTS];
+	struct poemgr_input_status old_input_status;
+};
+
+int64_t poemgr_time_ms(void);
+
+void poemgr_sched_init(struct poemgr_ctx *ctx, int64_t now);
+
+/* Refresh a port on the next run and follow it closely, e.g. after switching it on */
+void poemgr_sched_port_due(struct poemgr_ctx *ctx, int port, int64_t now);
+
+int poemgr_sched_run(struct poemgr_ctx *ctx, int64_t now, struct poemgr_sched_result *result);
+
+int64_t poemgr_sched_next_update(struct poemgr_ctx *ctx);
@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <time.h>
+
+#include "sim.h"
+
+static const struct poemgr_sim_pd poemgr_sim_pds[] = {
+	{ .present = 1, .poe_class = 4, .power = 12500 },
+	{ .present = 1, .poe_class = 2, .power = 4800 },
+	{ .present = 1, .poe_class = 0, .power = 2100 },
+	{ .present = 0 },
+};
+
+static const struct poemgr_sim_pd poemgr_sim_no_pd;
+
+static int64_t poemgr_sim_time_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+const struct poemgr_sim_pd *poemgr_sim_pd_get(int port)
+{
+	if (port < 0 || port >= (int) (sizeof(poemgr_sim_pds) / sizeof(poemgr_sim_pds[0])))
+		return &poemgr_sim_no_pd;
+
+	return &poemgr_sim_pds[port];
+}
+
+void poemgr_sim_port_reset(struct poemgr_sim_port *sim_port)
+{
+	sim_port->enabled = 1;
+	sim_port->enabled_at = 0;
+}
+
+void poemgr_sim_port_enable(struct poemgr_sim_port *sim_port, int enable)
+{
+	if (enable && !sim_port->enabled)
+		sim_port->enabled_at = poemgr_sim_time_ms();
+
+	sim_port->enabled = enable;
+}
+
+enum poemgr_sim_pd_state poemgr_sim_port_state(const struct poemgr_sim_port *sim_port, int port)
+{
+	int64_t elapsed;
+
+	if (!sim_port->enabled)
+		return POEMGR_SIM_PD_OFF;
+
+	elapsed = poemgr_sim_time_ms() - sim_port->enabled_at;
+	if (elapsed < POEMGR_SIM_DETECTION_TIME)
+		return POEMGR_SIM_PD_DETECTING;
+
+	if (!poemgr_sim_pd_get(port)->present)
+		return POEMGR_SIM_PD_OPEN;
+
+	elapsed -= POEMGR_SIM_DETECTION_TIME;
+	if (elapsed < POEMGR_SIM_CLASSIFICATION_TIME)
+		return POEMGR_SIM_PD_CLASSIFYING;
+
+	elapsed -= POEMGR_SIM_CLASSIFICATION_TIME;
+	if (elapsed < POEMGR_SIM_POWER_UP_TIME)
+		return POEMGR_SIM_PD_POWERING;
+
+	return POEMGR_SIM_PD_POWERED;
+}
+
+int poemgr_sim_port_current(const struct poemgr_sim_port *sim_port, int port)
+{
+	if (poemgr_sim_port_state(sim_port, port) != POEMGR_SIM_PD_POWERED)
+		return 0;
+
+	return (int64_t) poemgr_sim_pd_get(port)->power * 1000000 / POEMGR_SIM_PORT_VOLTAGE;
+}
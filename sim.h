@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Model of the powered devices attached to a simulated PSE, shared by the
+ * chip simulators. Times are in milliseconds after enabling a port.
+ */
+#define POEMGR_SIM_DETECTION_TIME	100
+#define POEMGR_SIM_CLASSIFICATION_TIME	50
+#define POEMGR_SIM_POWER_UP_TIME	60
+
+#define POEMGR_SIM_PORT_VOLTAGE		53500	/* mV */
+#define POEMGR_SIM_TEMPERATURE		45	/* Degrees C */
+
+enum poemgr_sim_pd_state {
+	POEMGR_SIM_PD_OFF,
+	POEMGR_SIM_PD_DETECTING,
+	/* No PD attached */
+	POEMGR_SIM_PD_OPEN,
+	POEMGR_SIM_PD_CLASSIFYING,
+	/* Power enabled, not yet good */
+	POEMGR_SIM_PD_POWERING,
+	POEMGR_SIM_PD_POWERED,
+};
+
+struct poemgr_sim_pd {
+	int present;
+	int poe_class;
+	int power;	/* mW */
+};
+
+struct poemgr_sim_port {
+	int enabled;
+	int64_t enabled_at;
+};
+
+const struct poemgr_sim_pd *poemgr_sim_pd_get(int port);
+
+/* Ports come out of reset enabled with their PD already powered */
+void poemgr_sim_port_reset(struct poemgr_sim_port *sim_port);
+
+void poemgr_sim_port_enable(struct poemgr_sim_port *sim_port, int enable);
+
+enum poemgr_sim_pd_state poemgr_sim_port_state(const struct poemgr_sim_port *sim_port, int port);
+
+/* Current drawn from the port in uA */
+int poemgr_sim_port_current(const struct poemgr_sim_port *sim_port, int port);
@@ -0,0 +1,133 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <stdio.h>
+
+#include "poemgr.h"
+#include "simtps23861.h"
+#include "pse.h"
+#include "tps23861.h"
+
+/**
+ * Reference board with a TPS23861 on a fixed 802.3bt input. Used with
+ * --simulate to exercise the PSE driver interface without hardware.
+ */
+
+#define SIMTPS23861_NUM_PORTS		POEMGR_SIMTPS23861_NUM_PORTS
+#define SIMTPS23861_NUM_PSE_CHIPS	1
+#define SIMTPS23861_PSE_CHIP_IDX	0
+#define SIMTPS23861_PSE_PORTMASK	0xF
+
+#define SIMTPS23861_I2C_BUS		0
+#define SIMTPS23861_I2C_ADDR		0x20
+
+#define SIMTPS23861_POWER_BUDGET	60	/* Watts */
+
+static int poemgr_simtps23861_read_power_budget(struct poemgr_ctx *ctx)
+{
+	if (ctx->settings.power_budget > 0)
+		return ctx->settings.power_budget;
+
+	return SIMTPS23861_POWER_BUDGET;
+}
+
+POEMGR_PROFILE_EXPORT int poemgr_simtps23861_init(struct poemgr_ctx *ctx)
+{
+	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, SIMTPS23861_PSE_CHIP_IDX);
+
+	psechip->ops = &tps23861_pse_ops;
+	if (poemgr_pse_ops(psechip)->init(psechip, &ctx->arena, SIMTPS23861_I2C_BUS, SIMTPS23861_I2C_ADDR,
+			       SIMTPS23861_PSE_PORTMASK))
+		return 1;
+
+	return 0;
+}
+
+POEMGR_PROFILE_EXPORT int poemgr_simtps23861_end(struct poemgr_ctx *ctx)
+{
+	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, SIMTPS23861_PSE_CHIP_IDX);
+
+	return poemgr_pse_ops(psechip)->end(psechip);
+}
+
+POEMGR_PROFILE_EXPORT int poemgr_simtps23861_ready(struct poemgr_ctx *ctx)
+{
+	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, SIMTPS23861_PSE_CHIP_IDX);
+
+	return poemgr_pse_ops(psechip)->online(psechip);
+}
+
+POEMGR_PROFILE_EXPORT int poemgr_simtps23861_enable(struct poemgr_ctx *ctx)
+{
+	/* The PSE is always powered */
+	return 0;
+}
+
+POEMGR_PROFILE_EXPORT int poemgr_simtps23861_disable(struct poemgr_ctx *ctx)
+{
+	return 0;
+}
+
+POEMGR_PROFILE_EXPORT int poemgr_simtps23861_update_port_status(struct poemgr_ctx *ctx, int port)
+{
+	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, SIMTPS23861_PSE_CHIP_IDX);
+
+	return poemgr_pse_update_port_status(psechip, port, &ctx->ports[port].status);
+}
+
+POEMGR_PROFILE_EXPORT int poemgr_simtps23861_update_output_status(struct poemgr_ctx *ctx)
+{
+	ctx->output_status.power_budget = poemgr_simtps23861_read_power_budget(ctx);
+
+	return 0;
+}
+
+POEMGR_PROFILE_EXPORT int poemgr_simtps23861_update_input_status(struct poemgr_ctx *ctx)
+{
+	ctx->input_status.type = POEMGR_POE_TYPE_BT;
+
+	return 0;
+}
+
+POEMGR_PROFILE_EXPORT int poemgr_simtps23861_apply_config(struct poemgr_ctx *ctx)
+{
+	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, SIMTPS23861_PSE_CHIP_IDX);
+	int ret;
+
+	ret = poemgr_pse_apply_config(ctx, psechip, poemgr_simtps23861_read_power_budget(ctx), NULL);
+	if (ret)
+		fprintf(stderr, "Error applying configuration to PSE\n");
+
+	return ret;
+}
+
+POEMGR_PROFILE_EXPORT int poemgr_simtps23861_set_ports_power(struct poemgr_ctx *ctx, uint32_t portmask, int enable)
+{
+	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, SIMTPS23861_PSE_CHIP_IDX);
+
+	return poemgr_pse_ops(psechip)->set_port_mode(psechip, portmask,
+					   enable ? POEMGR_PSE_PORT_MODE_AUTO : POEMGR_PSE_PORT_MODE_OFF);
+}
+
+POEMGR_PROFILE_EXPORT int poemgr_simtps23861_get_ports_power_good(struct poemgr_ctx *ctx)
+{
+	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, SIMTPS23861_PSE_CHIP_IDX);
+
+	return poemgr_pse_ops(psechip)->get_power_good(psechip);
+}
+
+struct poemgr_profile poemgr_profile_simtps23861 = {
+	.name = "sim-tps23861",
+	.num_ports = SIMTPS23861_NUM_PORTS,
+	.ready = &poemgr_simtps23861_ready,
+	.enable = &poemgr_simtps23861_enable,
+	.disable = &poemgr_simtps23861_disable,
+	.init = &poemgr_simtps23861_init,
+	.end = &poemgr_simtps23861_end,
+	.apply_config = &poemgr_simtps23861_apply_config,
+	.update_port_status = &poemgr_simtps23861_update_port_status,
+	.update_output_status = &poemgr_simtps23861_update_output_status,
+	.update_input_status = &poemgr_simtps23861_update_input_status,
+	.set_ports_power = &poemgr_simtps23861_set_ports_power,
+	.get_ports_power_good = &poemgr_simtps23861_get_ports_power_good,
+	.num_pse_chips = SIMTPS23861_NUM_PSE_CHIPS,
+};
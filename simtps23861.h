@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#define POEMGR_SIMTPS23861_NUM_PORTS	4
+
+#ifdef POEMGR_PROFILE
+
+#include <stdint.h>
+
+struct poemgr_ctx;
+struct poemgr_pse_ops;
+
+/* Callbacks of the single-profile build */
+#define poemgr_simtps23861_num_ports	POEMGR_SIMTPS23861_NUM_PORTS
+
+int poemgr_simtps23861_init(struct poemgr_ctx *ctx);
+int poemgr_simtps23861_end(struct poemgr_ctx *ctx);
+int poemgr_simtps23861_ready(struct poemgr_ctx *ctx);
+int poemgr_simtps23861_enable(struct poemgr_ctx *ctx);
+int poemgr_simtps23861_disable(struct poemgr_ctx *ctx);
+int poemgr_simtps23861_apply_config(struct poemgr_ctx *ctx);
+int poemgr_simtps23861_update_port_status(struct poemgr_ctx *ctx, int port);
+int poemgr_simtps23861_update_input_status(struct poemgr_ctx *ctx);
+int poemgr_simtps23861_update_output_status(struct poemgr_ctx *ctx);
+int poemgr_simtps23861_set_ports_power(struct poemgr_ctx *ctx, uint32_t portmask, int enable);
+int poemgr_simtps23861_get_ports_power_good(struct poemgr_ctx *ctx);
+
+/* Driver of the only PSE chip */
+extern const struct poemgr_pse_ops tps23861_pse_ops;
+#define POEMGR_PROFILE_PSE_OPS		tps23861_pse_ops
+
+#endif
@@ -0,0 +1,395 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/i2c-dev.h>
+
+#include <sys/ioctl.h>
+
+#include "capture.h"
+#include "smbus.h"
+#include "trace.h"
+
+/* Transfer retry policy */
+#define POEMGR_SMBUS_XFER_DEADLINE_US	20000	/* Give up on a transfer after */
+#define POEMGR_SMBUS_XFER_BACKOFF_US	250	/* Initial backoff, doubled per retry */
+
+/* Error budget: Failed attempts tolerated per window before the chip is marked degraded */
+#define POEMGR_SMBUS_ERROR_BUDGET		8
+#define POEMGR_SMBUS_ERROR_WINDOW_US		10000000
+#define POEMGR_SMBUS_DEGRADED_HOLDOFF_US	5000000
+
+/* Read unused registers between two ranges instead of starting a new transfer */
+#define POEMGR_SMBUS_PLAN_MAX_GAP	3
+
+int poemgr_smbus_simulate;
+
+static int32_t i2c_smbus_access(int file, char read_write, uint8_t command,
+				int size, union i2c_smbus_data *data)
+{
+	struct i2c_smbus_ioctl_data args;
+
+	args.read_write = read_write;
+	args.command = command;
+	args.size = size;
+	args.data = data;
+	return ioctl(file,I2C_SMBUS,&args);
+}
+
+static int64_t poemgr_smbus_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int poemgr_smbus_sim_access(struct poemgr_smbus *bus, char read_write, uint8_t reg,
+				   int size, union i2c_smbus_data *data)
+{
+	if (size == I2C_SMBUS_BYTE_DATA) {
+		if (read_write == I2C_SMBUS_READ)
+			data->byte = bus->sim->read(bus->sim_state, reg);
+		else
+			bus->sim->write(bus->sim_state, reg, data->byte);
+
+		return 0;
+	}
+
+	if (size == I2C_SMBUS_I2C_BLOCK_DATA && read_write == I2C_SMBUS_READ &&
+	    data->block[0] <= I2C_SMBUS_BLOCK_MAX) {
+		for (int i = 0; i < data->block[0]; i++)
+			data->block[i + 1] = bus->sim->read(bus->sim_state, reg + i);
+
+		return 0;
+	}
+
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+/* Transport, optionally recorded to or replayed from a capture */
+static int poemgr_smbus_access(struct poemgr_smbus *bus, char read_write, uint8_t reg,
+			       int size, union i2c_smbus_data *data)
+{
+	int64_t start, latency;
+	int ret, err;
+
+	if (poemgr_capture_replaying())
+		return poemgr_capture_replay(bus->addr, read_write, reg, size, data);
+
+	start = poemgr_capture_recording() ? poemgr_smbus_time_us() : 0;
+
+	if (bus->sim)
+		ret = poemgr_smbus_sim_access(bus, read_write, reg, size, data);
+	else
+		ret = i2c_smbus_access(bus->fd, read_write, reg, size, data);
+
+	if (!poemgr_capture_recording())
+		return ret;
+
+	err = ret ? errno : 0;
+	latency = poemgr_smbus_time_us() - start;
+
+	poemgr_capture_record(bus->addr, read_write, reg, size, data, start, latency, err);
+
+	errno = err;
+	return ret;
+}
+
+static uint32_t poemgr_smbus_random(struct poemgr_smbus *bus)
+{
+	/* xorshift32 */
+	bus->rand_state ^= bus->rand_state << 13;
+	bus->rand_state ^= bus->rand_state >> 17;
+	bus->rand_state ^= bus->rand_state << 5;
+
+	return bus->rand_state;
+}
+
+static int poemgr_smbus_xfer_retryable(int err)
+{
+	/* Unsupported transfers and invalid arguments won't succeed on retry */
+	switch (err) {
+		case EINVAL:
+		case EBADF:
+		case ENOTTY:
+		case EOPNOTSUPP:
+			return 0;
+		default:
+			return 1;
+	}
+}
+
+static void poemgr_smbus_error_account(struct poemgr_smbus *bus, int64_t now)
+{
+	bus->xfer_errors++;
+
+	if (now - bus->error_window_start > POEMGR_SMBUS_ERROR_WINDOW_US) {
+		bus->error_window_start = now;
+		bus->error_window_count = 0;
+	}
+
+	/* A failed probe of a degraded chip always renews the holdoff, even in a new window */
+	if (++bus->error_window_count < POEMGR_SMBUS_ERROR_BUDGET && !bus->degraded)
+		return;
+
+	/* Budget exhausted. Stop accessing the chip for a while. */
+	if (!bus->degraded)
+		fprintf(stderr, "%s at 0x%02x degraded after %d transfer errors\n",
+			bus->name, bus->addr, bus->error_window_count);
+
+	bus->degraded = 1;
+	bus->degraded_until = now + POEMGR_SMBUS_DEGRADED_HOLDOFF_US;
+}
+
+/**
+ * Perform a SMBus transfer. Failed transfers are retried with jittered,
+ * exponential backoff until the deadline passes. While the chip is degraded,
+ * transfers fail immediately except for a single probe after the holdoff.
+ */
+static int poemgr_smbus_xfer(struct poemgr_smbus *bus, char read_write, uint8_t reg,
+			     int size, union i2c_smbus_data *data)
+{
+	union i2c_smbus_data data_in = *data;
+	int64_t start, now, backoff, span;
+	int attempt = 0;
+	int ret, err;
+
+	start = poemgr_smbus_time_us();
+
+	if (bus->degraded && start < bus->degraded_until) {
+		errno = EIO;
+		return -1;
+	}
+
+	bus->xfers++;
+
+	while (1) {
+		span = poemgr_trace_begin();
+		ret = poemgr_smbus_access(bus, read_write, reg, size, data);
+		err = ret ? errno : 0;
+		poemgr_trace_end(span, "i2c", read_write == I2C_SMBUS_READ ? "read" : "write", 4,
+				 "reg", reg, "size", size, "attempt", attempt, "result", -err);
+
+		if (!ret) {
+			if (bus->degraded) {
+				fprintf(stderr, "%s at 0x%02x recovered\n", bus->name, bus->addr);
+				bus->degraded = 0;
+				bus->error_window_count = 0;
+			}
+
+			return 0;
+		}
+
+		if (!poemgr_smbus_xfer_retryable(err))
+			break;
+
+		now = poemgr_smbus_time_us();
+		poemgr_smbus_error_account(bus, now);
+
+		/* Failed probe of a degraded chip, don't retry */
+		if (bus->degraded)
+			break;
+
+		/* Jitter between 50% and 150% of the backoff */
+		backoff = (int64_t) POEMGR_SMBUS_XFER_BACKOFF_US << attempt++;
+		backoff = backoff / 2 + poemgr_smbus_random(bus) % (backoff + 1);
+
+		if (now + backoff - start > POEMGR_SMBUS_XFER_DEADLINE_US)
+			break;
+
+		usleep(backoff);
+
+		/* Transfer buffer is overwritten by failed reads */
+		*data = data_in;
+	}
+
+	errno = err;
+	return -1;
+}
+
+int poemgr_smbus_write_byte(struct poemgr_smbus *bus, uint8_t reg, uint8_t val)
+{
+	union i2c_smbus_data data;
+
+	data.byte = val;
+
+	return poemgr_smbus_xfer(bus, I2C_SMBUS_WRITE, reg, I2C_SMBUS_BYTE_DATA, &data);
+}
+
+int poemgr_smbus_read_byte(struct poemgr_smbus *bus, uint8_t reg)
+{
+	union i2c_smbus_data data;
+
+	if (poemgr_smbus_xfer(bus, I2C_SMBUS_READ, reg, I2C_SMBUS_BYTE_DATA, &data))
+		return -1;
+	
+	return 0x0FF & data.byte;
+}
+
+int poemgr_smbus_read_block(struct poemgr_smbus *bus, uint8_t reg, uint8_t len, uint8_t *buf)
+{
+	union i2c_smbus_data data;
+	int val, ret;
+
+	if (len > 1 && !bus->no_block_read) {
+		data.block[0] = len;
+		ret = poemgr_smbus_xfer(bus, I2C_SMBUS_READ, reg, I2C_SMBUS_I2C_BLOCK_DATA, &data);
+		if (!ret && data.block[0] == len) {
+			memcpy(buf, &data.block[1], len);
+			return 0;
+		}
+
+		/* Don't fall back to byte reads in case the bus is the problem */
+		if (ret && poemgr_smbus_xfer_retryable(errno))
+			return -1;
+	}
+
+	/* Single register or adapter without block read support */
+	for (int i = 0; i < len; i++) {
+		val = poemgr_smbus_read_byte(bus, reg + i);
+		if (val < 0)
+			return val;
+
+		buf[i] = val;
+	}
+
+	/* Block reads unsupported while byte reads work. Don't try again. */
+	if (len > 1)
+		bus->no_block_read = 1;
+
+	return 0;
+}
+
+int poemgr_smbus_update(struct poemgr_smbus *bus, uint8_t reg, uint8_t mask, uint8_t val)
+{
+	int reg_val;
+
+	/* Skip read-modify-write for fields spanning the whole register */
+	if (mask == 0xFF)
+		return poemgr_smbus_write_byte(bus, reg, val);
+
+	reg_val = poemgr_smbus_read_byte(bus, reg);
+	if (reg_val < 0)
+		return reg_val;
+
+	reg_val &= ~mask;
+	reg_val |= val & mask;
+
+	return poemgr_smbus_write_byte(bus, reg, reg_val);
+}
+
+void poemgr_smbus_plan_build(struct poemgr_smbus_read_plan *plan, const uint8_t *needed)
+{
+	struct poemgr_smbus_read_range *range = NULL;
+	int gap = 0;
+
+	plan->num_ranges = 0;
+	for (int reg = 0; reg < POEMGR_SMBUS_NUM_REGS; reg++) {
+		if (!needed[reg]) {
+			gap++;
+			continue;
+		}
+
+		if (range && gap <= POEMGR_SMBUS_PLAN_MAX_GAP &&
+		    range->len + gap + 1 <= I2C_SMBUS_BLOCK_MAX) {
+			/* Extend current range */
+			range->len += gap + 1;
+		} else {
+			range = &plan->ranges[plan->num_ranges++];
+			range->reg = reg;
+			range->len = 1;
+		}
+
+		gap = 0;
+	}
+}
+
+int poemgr_smbus_plan_exec(struct poemgr_smbus *bus, const struct poemgr_smbus_read_plan *plan, uint8_t *regs)
+{
+	const struct poemgr_smbus_read_range *range;
+	int ret;
+
+	for (int i = 0; i < plan->num_ranges; i++) {
+		range = &plan->ranges[i];
+
+		ret = poemgr_smbus_read_block(bus, range->reg, range->len, &regs[range->reg]);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+int poemgr_smbus_open(struct poemgr_smbus *bus, struct poemgr_arena *arena, const char *name,
+		      int i2c_bus, int addr, const struct poemgr_smbus_sim *sim)
+{
+	char i2cpath[30];
+	int fd;
+
+	memset(bus, 0, sizeof(*bus));
+	bus->name = name;
+	bus->fd = -1;
+	bus->addr = addr;
+	bus->rand_state = (uint32_t) poemgr_smbus_time_us() | 1;
+
+	/* Transfers are served from the capture */
+	if (poemgr_capture_replaying())
+		return 0;
+
+	if (poemgr_smbus_simulate) {
+		if (!sim) {
+			fprintf(stderr, "No simulator for %s\n", name);
+			return 1;
+		}
+
+		/* Released together with the configuration generation */
+		bus->sim_state = poemgr_arena_alloc(arena, sim->state_size);
+		if (!bus->sim_state)
+			return 1;
+
+		bus->sim = sim;
+		sim->init(bus->sim_state);
+		return 0;
+	}
+
+	snprintf(i2cpath, sizeof(i2cpath), "/dev/i2c-%d", i2c_bus);
+
+	/* Not inherited by hotplug handlers */
+	fd = open(i2cpath, O_RDWR | O_CLOEXEC);
+
+	if (fd == -1) {
+		perror(i2cpath);
+		return 1;
+	}
+
+	if (ioctl(fd, I2C_SLAVE, addr) < 0) {
+		perror("i2c_set_address");
+		close(fd);
+		return 1;
+	}
+
+	bus->fd = fd;
+
+	return 0;
+}
+
+int poemgr_smbus_close(struct poemgr_smbus *bus)
+{
+	int ret;
+
+	if (bus->fd < 0)
+		return 0;
+
+	ret = !!close(bus->fd);
+	bus->fd = -1;
+
+	return ret;
+}
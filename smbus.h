@@ -0,0 +1,80 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <linux/i2c.h>
+
+#include "arena.h"
+
+#define POEMGR_SMBUS_NUM_REGS		0x100
+#define POEMGR_SMBUS_PLAN_MAX_RANGES	16
+
+struct poemgr_smbus_read_range {
+	uint8_t reg;
+	uint8_t len;
+};
+
+/* Coalesced block reads covering a set of registers */
+struct poemgr_smbus_read_plan {
+	int num_ranges;
+	struct poemgr_smbus_read_range ranges[POEMGR_SMBUS_PLAN_MAX_RANGES];
+};
+
+/* Register-level model of a chip, accessed instead of the bus with --simulate */
+struct poemgr_smbus_sim {
+	size_t state_size;
+	void (*init)(void *state);
+	uint8_t (*read)(void *state, uint8_t reg);
+	void (*write)(void *state, uint8_t reg, uint8_t val);
+};
+
+struct poemgr_smbus {
+	const char *name;
+
+	int fd;
+	int addr;
+
+	/* Adapter does not support I2C block reads */
+	int no_block_read;
+
+	/* Transfer statistics */
+	uint32_t xfers;
+	uint32_t xfer_errors;
+
+	/* Error budget */
+	int64_t error_window_start;
+	int error_window_count;
+	int degraded;
+	int64_t degraded_until;
+
+	uint32_t rand_state;
+
+	/* Simulated chip, NULL when accessing the bus */
+	const struct poemgr_smbus_sim *sim;
+	void *sim_state;
+};
+
+/* Use chip simulators instead of the bus */
+extern int poemgr_smbus_simulate;
+
+int poemgr_smbus_open(struct poemgr_smbus *bus, struct poemgr_arena *arena, const char *name,
+		      int i2c_bus, int addr, const struct poemgr_smbus_sim *sim);
+
+int poemgr_smbus_close(struct poemgr_smbus *bus);
+
+int poemgr_smbus_read_byte(struct poemgr_smbus *bus, uint8_t reg);
+
+int poemgr_smbus_write_byte(struct poemgr_smbus *bus, uint8_t reg, uint8_t val);
+
+int poemgr_smbus_read_block(struct poemgr_smbus *bus, uint8_t reg, uint8_t len, uint8_t *buf);
+
+/* Read-modify-write of the bits in mask */
+int poemgr_smbus_update(struct poemgr_smbus *bus, uint8_t reg, uint8_t mask, uint8_t val);
+
+/* needed holds a non-zero entry for every register to read */
+void poemgr_smbus_plan_build(struct poemgr_smbus_read_plan *plan, const uint8_t *needed);
+
+int poemgr_smbus_plan_exec(struct poemgr_smbus *bus, const struct poemgr_smbus_read_plan *plan, uint8_t *regs);
@@ -0,0 +1,1103 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "daemon.h"
+#include "scheduler.h"
+#include "snmp.h"
+#include "thermal.h"
+
+/**
+ * AgentX (RFC 2741) subagent serving pethPsePortTable and pethMainPseTable
+ * of the POWER-ETHERNET-MIB (RFC 3621) from the status cached by the daemon,
+ * so walks don't cause any bus traffic to the PSE. Sets of the port admin
+ * status switch just that port, priority sets only change the settings.
+ * Neither is written to the configuration.
+ */
+
+#define AGENTX_VERSION			1
+#define AGENTX_HEADER_LEN		20
+#define AGENTX_MAX_PAYLOAD		8192
+#define AGENTX_MAX_OID_LEN		128
+#define AGENTX_TIMEOUT			1000	/* ms */
+#define AGENTX_RECONNECT_INTERVAL	10000	/* ms */
+#define AGENTX_MAX_BULK_RANGES		32
+
+/* PDU types */
+#define AGENTX_OPEN_PDU			1
+#define AGENTX_CLOSE_PDU		2
+#define AGENTX_REGISTER_PDU		3
+#define AGENTX_GET_PDU			5
+#define AGENTX_GETNEXT_PDU		6
+#define AGENTX_GETBULK_PDU		7
+#define AGENTX_TESTSET_PDU		8
+#define AGENTX_COMMITSET_PDU		9
+#define AGENTX_UNDOSET_PDU		10
+#define AGENTX_CLEANUPSET_PDU		11
+#define AGENTX_RESPONSE_PDU		18
+
+#define AGENTX_FLAG_NETWORK_BYTE_ORDER	0x10
+
+/* Varbind types */
+#define AGENTX_INTEGER			2
+#define AGENTX_OCTET_STRING		4
+#define AGENTX_COUNTER32		65
+#define AGENTX_GAUGE32			66
+#define AGENTX_NO_SUCH_OBJECT		128
+#define AGENTX_NO_SUCH_INSTANCE		129
+#define AGENTX_END_OF_MIB_VIEW		130
+
+/* Errors */
+#define AGENTX_ERR_NONE			0
+#define AGENTX_ERR_GEN			5
+#define AGENTX_ERR_WRONG_TYPE		7
+#define AGENTX_ERR_WRONG_VALUE		10
+#define AGENTX_ERR_INCONSISTENT_VALUE	12
+#define AGENTX_ERR_COMMIT_FAILED	14
+#define AGENTX_ERR_UNDO_FAILED		15
+#define AGENTX_ERR_NOT_WRITABLE		17
+#define AGENTX_ERR_CLOSE_SHUTDOWN	5
+
+/* POWER-ETHERNET-MIB */
+#define PETH_PSE_PORT_TABLE		1, 3, 6, 1, 2, 1, 105, 1, 1
+#define PETH_PSE_PORT_TABLE_LEN		9
+/* pethMainPseObjects.1 */
+#define PETH_MAIN_PSE_TABLE		1, 3, 6, 1, 2, 1, 105, 1, 3, 1
+#define PETH_MAIN_PSE_TABLE_LEN		10
+
+#define PETH_PSE_GROUP_INDEX		1
+
+enum peth_pse_port_column {
+	PETH_PSE_PORT_ADMIN_ENABLE = 3,
+	PETH_PSE_PORT_POWER_PAIRS_CONTROL_ABILITY,
+	PETH_PSE_PORT_POWER_PAIRS,
+	PETH_PSE_PORT_DETECTION_STATUS,
+	PETH_PSE_PORT_POWER_PRIORITY,
+	PETH_PSE_PORT_MPS_ABSENT_COUNTER,
+	PETH_PSE_PORT_TYPE,
+	PETH_PSE_PORT_POWER_CLASSIFICATIONS,
+	PETH_PSE_PORT_INVALID_SIGNATURE_COUNTER,
+	PETH_PSE_PORT_POWER_DENIED_COUNTER,
+	PETH_PSE_PORT_OVER_LOAD_COUNTER,
+	PETH_PSE_PORT_SHORT_COUNTER,
+	__PETH_PSE_PORT_COLUMN_MAX,
+};
+
+enum peth_main_pse_column {
+	PETH_MAIN_PSE_POWER = 2,
+	PETH_MAIN_PSE_OPER_STATUS,
+	PETH_MAIN_PSE_CONSUMPTION_POWER,
+	__PETH_MAIN_PSE_COLUMN_MAX,
+};
+
+#define PETH_TRUE				1
+#define PETH_FALSE				2
+
+#define PETH_POWER_PAIRS_SIGNAL			1
+
+#define PETH_DETECTION_STATUS_DISABLED		1
+#define PETH_DETECTION_STATUS_SEARCHING		2
+#define PETH_DETECTION_STATUS_DELIVERING_POWER	3
+#define PETH_DETECTION_STATUS_FAULT		4
+
+#define PETH_PRIORITY_CRITICAL			1
+#define PETH_PRIORITY_HIGH			2
+#define PETH_PRIORITY_LOW			3
+
+#define PETH_OPER_STATUS_ON			1
+#define PETH_OPER_STATUS_OFF			2
+
+/* Faults counted as invalid signature */
+#define POEMGR_SNMP_FAULTS_SIGNATURE	(POEMGR_FAULT_TYPE_RESISTANCE_TOO_LOW | \
+					 POEMGR_FAULT_TYPE_RESISTANCE_TOO_HIGH | \
+					 POEMGR_FAULT_TYPE_CAPACITY_TOO_HIGH)
+
+struct poemgr_snmp_oid {
+	uint32_t sub[AGENTX_MAX_OID_LEN];
+	int len;
+	int include;
+};
+
+struct poemgr_snmp_value {
+	uint16_t type;
+	uint32_t num;
+	const char *str;
+};
+
+struct poemgr_snmp_pdu {
+	uint8_t type;
+	uint8_t flags;
+	uint32_t session_id;
+	uint32_t transaction_id;
+	uint32_t packet_id;
+	uint32_t len;
+	uint8_t payload[AGENTX_MAX_PAYLOAD];
+};
+
+struct poemgr_snmp_reader {
+	const uint8_t *p;
+	const uint8_t *end;
+	int nbo;
+	int error;
+};
+
+struct poemgr_snmp_writer {
+	uint8_t data[AGENTX_HEADER_LEN + AGENTX_MAX_PAYLOAD];
+	size_t len;
+	int overflow;
+};
+
+struct poemgr_snmp_port_counters {
+	uint32_t mps_absent;
+	uint32_t invalid_signature;
+	uint32_t power_denied;
+	uint32_t overload;
+	uint32_t shorts;
+};
+
+struct poemgr_snmp_set {
+	int port;
+	int column;
+	uint32_t value;
+};
+
+static struct poemgr_ctx *poemgr_snmp_poemgr_ctx;
+static const char *poemgr_snmp_path;
+static int poemgr_snmp_sock = -1;
+static int poemgr_snmp_warned;
+static int64_t poemgr_snmp_next_connect;
+static uint32_t poemgr_snmp_session_id;
+static uint32_t poemgr_snmp_packet_id;
+
+static struct poemgr_snmp_pdu poemgr_snmp_rx;
+static struct poemgr_snmp_writer poemgr_snmp_tx;
+
+static struct poemgr_snmp_port_counters poemgr_snmp_counters[POEMGR_MAX_PORTS];
+
+/* Set transaction in progress and the port settings to restore on undo */
+static struct poemgr_snmp_set poemgr_snmp_sets[POEMGR_MAX_PORTS * 2];
+static int poemgr_snmp_num_sets;
+static struct poemgr_port_settings poemgr_snmp_undo[POEMGR_MAX_PORTS];
+
+static const uint32_t peth_pse_port_table[] = { PETH_PSE_PORT_TABLE };
+static const uint32_t peth_main_pse_table[] = { PETH_MAIN_PSE_TABLE };
+
+/* Encoding */
+
+static void poemgr_snmp_put(struct poemgr_snmp_writer *w, const void *data, size_t len)
+{
+	if (w->len + len > sizeof(w->data)) {
+		w->overflow = 1;
+		return;
+	}
+
+	memcpy(&w->data[w->len], data, len);
+	w->len += len;
+}
+
+static void poemgr_snmp_put_u16(struct poemgr_snmp_writer *w, uint16_t val)
+{
+	uint8_t buf[2] = { val >> 8, val };
+
+	poemgr_snmp_put(w, buf, sizeof(buf));
+}
+
+static void poemgr_snmp_put_u32(struct poemgr_snmp_writer *w, uint32_t val)
+{
+	uint8_t buf[4] = { val >> 24, val >> 16, val >> 8, val };
+
+	poemgr_snmp_put(w, buf, sizeof(buf));
+}
+
+static void poemgr_snmp_put_oid(struct poemgr_snmp_writer *w, const uint32_t *sub, int len, int include)
+{
+	uint8_t buf[4] = { len, 0, include, 0 };
+
+	poemgr_snmp_put(w, buf, sizeof(buf));
+	for (int i = 0; i < len; i++)
+		poemgr_snmp_put_u32(w, sub[i]);
+}
+
+static void poemgr_snmp_put_octets(struct poemgr_snmp_writer *w, const char *str)
+{
+	static const uint8_t pad[3];
+	size_t len = strlen(str);
+
+	poemgr_snmp_put_u32(w, len);
+	poemgr_snmp_put(w, str, len);
+	poemgr_snmp_put(w, pad, (4 - len % 4) % 4);
+}
+
+static void poemgr_snmp_put_varbind(struct poemgr_snmp_writer *w, const struct poemgr_snmp_oid *oid,
+				    const struct poemgr_snmp_value *value)
+{
+	poemgr_snmp_put_u16(w, value->type);
+	poemgr_snmp_put_u16(w, 0);
+	poemgr_snmp_put_oid(w, oid->sub, oid->len, 0);
+
+	switch (value->type) {
+		case AGENTX_INTEGER:
+		case AGENTX_COUNTER32:
+		case AGENTX_GAUGE32:
+			poemgr_snmp_put_u32(w, value->num);
+			break;
+		case AGENTX_OCTET_STRING:
+			poemgr_snmp_put_octets(w, value->str);
+			break;
+		default:
+			/* Exceptions have no data */
+			break;
+	}
+}
+
+static void poemgr_snmp_put_header(struct poemgr_snmp_writer *w, uint8_t type, uint32_t transaction_id,
+				   uint32_t packet_id)
+{
+	uint8_t buf[4] = { AGENTX_VERSION, type, AGENTX_FLAG_NETWORK_BYTE_ORDER, 0 };
+
+	w->len = 0;
+	w->overflow = 0;
+
+	poemgr_snmp_put(w, buf, sizeof(buf));
+	poemgr_snmp_put_u32(w, poemgr_snmp_session_id);
+	poemgr_snmp_put_u32(w, transaction_id);
+	poemgr_snmp_put_u32(w, packet_id);
+	/* Payload length, set by poemgr_snmp_send */
+	poemgr_snmp_put_u32(w, 0);
+}
+
+static int poemgr_snmp_send(struct poemgr_snmp_writer *w)
+{
+	uint32_t len = w->len - AGENTX_HEADER_LEN;
+	size_t sent = 0;
+	ssize_t ret;
+
+	if (w->overflow) {
+		fprintf(stderr, "AgentX PDU too large\n");
+		return 1;
+	}
+
+	w->data[16] = len >> 24;
+	w->data[17] = len >> 16;
+	w->data[18] = len >> 8;
+	w->data[19] = len;
+
+	while (sent < w->len) {
+		ret = send(poemgr_snmp_sock, &w->data[sent], w->len - sent, MSG_NOSIGNAL);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			return 1;
+
+		sent += ret;
+	}
+
+	return 0;
+}
+
+/* Decoding */
+
+static uint32_t poemgr_snmp_get_u32(struct poemgr_snmp_reader *r)
+{
+	const uint8_t *p = r->p;
+
+	if (r->end - r->p < 4) {
+		r->error = 1;
+		return 0;
+	}
+
+	r->p += 4;
+
+	if (r->nbo)
+		return (uint32_t) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+
+	return (uint32_t) p[3] << 24 | p[2] << 16 | p[1] << 8 | p[0];
+}
+
+static uint16_t poemgr_snmp_get_u16(struct poemgr_snmp_reader *r)
+{
+	const uint8_t *p = r->p;
+
+	if (r->end - r->p < 2) {
+		r->error = 1;
+		return 0;
+	}
+
+	r->p += 2;
+
+	return r->nbo ? p[0] << 8 | p[1] : p[1] << 8 | p[0];
+}
+
+static void poemgr_snmp_get_oid(struct poemgr_snmp_reader *r, struct poemgr_snmp_oid *oid)
+{
+	int n_subid, prefix;
+
+	oid->len = 0;
+
+	if (r->end - r->p < 4) {
+		r->error = 1;
+		return;
+	}
+
+	n_subid = r->p[0];
+	prefix = r->p[1];
+	oid->include = r->p[2];
+	r->p += 4;
+
+	/* Prefix n is short for 1.3.6.1.n */
+	if (prefix) {
+		oid->sub[0] = 1;
+		oid->sub[1] = 3;
+		oid->sub[2] = 6;
+		oid->sub[3] = 1;
+		oid->sub[4] = prefix;
+		oid->len = 5;
+	}
+
+	if (oid->len + n_subid > AGENTX_MAX_OID_LEN) {
+		r->error = 1;
+		return;
+	}
+
+	for (int i = 0; i < n_subid; i++)
+		oid->sub[oid->len++] = poemgr_snmp_get_u32(r);
+}
+
+static void poemgr_snmp_get_value(struct poemgr_snmp_reader *r, uint16_t type, struct poemgr_snmp_value *value)
+{
+	struct poemgr_snmp_oid oid;
+	uint32_t len;
+
+	value->type = type;
+	value->num = 0;
+
+	switch (type) {
+		case AGENTX_INTEGER:
+		case AGENTX_COUNTER32:
+		case AGENTX_GAUGE32:
+		case 67:	/* TimeTicks */
+			value->num = poemgr_snmp_get_u32(r);
+			break;
+		case 70:	/* Counter64 */
+			poemgr_snmp_get_u32(r);
+			poemgr_snmp_get_u32(r);
+			break;
+		case 6:		/* Object Identifier */
+			poemgr_snmp_get_oid(r, &oid);
+			break;
+		case AGENTX_OCTET_STRING:
+		case 64:	/* IpAddress */
+		case 68:	/* Opaque */
+			len = poemgr_snmp_get_u32(r);
+			len = (len + 3) & ~3;
+			if (len > (size_t) (r->end - r->p))
+				r->error = 1;
+			else
+				r->p += len;
+			break;
+		default:
+			/* Null and exceptions have no data */
+			break;
+	}
+}
+
+/* MIB */
+
+static int poemgr_snmp_oid_cmp(const struct poemgr_snmp_oid *a, const struct poemgr_snmp_oid *b)
+{
+	for (int i = 0; i < a->len && i < b->len; i++) {
+		if (a->sub[i] != b->sub[i])
+			return a->sub[i] < b->sub[i] ? -1 : 1;
+	}
+
+	return a->len - b->len;
+}
+
+static void poemgr_snmp_oid_set(struct poemgr_snmp_oid *oid, const uint32_t *table, int table_len, int column,
+				int index1, int index2)
+{
+	memcpy(oid->sub, table, table_len * sizeof(uint32_t));
+	oid->len = table_len;
+
+	/* Entry */
+	oid->sub[oid->len++] = 1;
+	oid->sub[oid->len++] = column;
+	oid->sub[oid->len++] = index1;
+	if (index2)
+		oid->sub[oid->len++] = index2;
+}
+
+static void poemgr_snmp_int(struct poemgr_snmp_value *value, uint16_t type, uint32_t num)
+{
+	value->type = type;
+	value->num = num;
+}
+
+static uint32_t poemgr_snmp_detection_status(struct poemgr_port_status *status)
+{
+	if (!status->enabled)
+		return PETH_DETECTION_STATUS_DISABLED;
+
+	if (status->active)
+		return PETH_DETECTION_STATUS_DELIVERING_POWER;
+
+	/* Nothing connected */
+	if (status->faults & ~POEMGR_FAULT_TYPE_OPEN_CIRCUIT)
+		return PETH_DETECTION_STATUS_FAULT;
+
+	return PETH_DETECTION_STATUS_SEARCHING;
+}
+
+static uint32_t poemgr_snmp_priority(enum poemgr_port_priority priority)
+{
+	if (priority == POEMGR_PORT_PRIORITY_CRITICAL)
+		return PETH_PRIORITY_CRITICAL;
+	if (priority == POEMGR_PORT_PRIORITY_HIGH)
+		return PETH_PRIORITY_HIGH;
+
+	return PETH_PRIORITY_LOW;
+}
+
+static void poemgr_snmp_port_value(struct poemgr_ctx *ctx, int port, int column, struct poemgr_snmp_value *value)
+{
+	struct poemgr_port_settings *settings = &ctx->ports[port].settings;
+	struct poemgr_port_status *status = &ctx->ports[port].status;
+	struct poemgr_snmp_port_counters *counters = &poemgr_snmp_counters[port];
+
+	switch (column) {
+		case PETH_PSE_PORT_ADMIN_ENABLE:
+			poemgr_snmp_int(value, AGENTX_INTEGER,
+					settings->name && !settings->disabled ? PETH_TRUE : PETH_FALSE);
+			break;
+		case PETH_PSE_PORT_POWER_PAIRS_CONTROL_ABILITY:
+			poemgr_snmp_int(value, AGENTX_INTEGER, PETH_FALSE);
+			break;
+		case PETH_PSE_PORT_POWER_PAIRS:
+			poemgr_snmp_int(value, AGENTX_INTEGER, PETH_POWER_PAIRS_SIGNAL);
+			break;
+		case PETH_PSE_PORT_DETECTION_STATUS:
+			poemgr_snmp_int(value, AGENTX_INTEGER, poemgr_snmp_detection_status(status));
+			break;
+		case PETH_PSE_PORT_POWER_PRIORITY:
+			poemgr_snmp_int(value, AGENTX_INTEGER, poemgr_snmp_priority(settings->priority));
+			break;
+		case PETH_PSE_PORT_MPS_ABSENT_COUNTER:
+			poemgr_snmp_int(value, AGENTX_COUNTER32, counters->mps_absent);
+			break;
+		case PETH_PSE_PORT_TYPE:
+			value->type = AGENTX_OCTET_STRING;
+			value->str = settings->name ? settings->name : "";
+			break;
+		case PETH_PSE_PORT_POWER_CLASSIFICATIONS:
+			/* class0(1) .. class4(5), only valid while delivering power */
+			poemgr_snmp_int(value, AGENTX_INTEGER, status->poe_class > 0 ? status->poe_class + 1 : 1);
+			break;
+		case PETH_PSE_PORT_INVALID_SIGNATURE_COUNTER:
+			poemgr_snmp_int(value, AGENTX_COUNTER32, counters->invalid_signature);
+			break;
+		case PETH_PSE_PORT_POWER_DENIED_COUNTER:
+			poemgr_snmp_int(value, AGENTX_COUNTER32, counters->power_denied);
+			break;
+		case PETH_PSE_PORT_OVER_LOAD_COUNTER:
+			poemgr_snmp_int(value, AGENTX_COUNTER32, counters->overload);
+			break;
+		case PETH_PSE_PORT_SHORT_COUNTER:
+			poemgr_snmp_int(value, AGENTX_COUNTER32, counters->shorts);
+			break;
+	}
+}
+
+static void poemgr_snmp_main_value(struct poemgr_ctx *ctx, int column, struct poemgr_snmp_value *value)
+{
+	uint32_t consumption = 0;
+
+	switch (column) {
+		case PETH_MAIN_PSE_POWER:
+			poemgr_snmp_int(value, AGENTX_GAUGE32, ctx->output_status.power_budget);
+			break;
+		case PETH_MAIN_PSE_OPER_STATUS:
+			poemgr_snmp_int(value, AGENTX_INTEGER,
+					ctx->settings.disabled ? PETH_OPER_STATUS_OFF : PETH_OPER_STATUS_ON);
+			break;
+		case PETH_MAIN_PSE_CONSUMPTION_POWER:
+			for (int i = 0; i < poemgr_profile_num_ports(ctx); i++)
+				consumption += ctx->ports[i].status.power;
+
+			poemgr_snmp_int(value, AGENTX_GAUGE32, consumption);
+			break;
+	}
+}
+
+/**
+ * Finds the first object compared to oid by cmp: == 0 for an exact match,
+ * > 0 for the next object (>= 0 if include). Objects are visited in
+ * lexicographical order. Returns 1 if found.
+ */
+static int poemgr_snmp_find(struct poemgr_ctx *ctx, const struct poemgr_snmp_oid *oid, int next,
+			    struct poemgr_snmp_oid *found, struct poemgr_snmp_value *value)
+{
+	int cmp;
+
+	for (int column = PETH_PSE_PORT_ADMIN_ENABLE; column < __PETH_PSE_PORT_COLUMN_MAX; column++) {
+		for (int port = 0; port < poemgr_profile_num_ports(ctx); port++) {
+			poemgr_snmp_oid_set(found, peth_pse_port_table, PETH_PSE_PORT_TABLE_LEN, column,
+					    PETH_PSE_GROUP_INDEX, port + 1);
+
+			cmp = poemgr_snmp_oid_cmp(found, oid);
+			if (next ? cmp > 0 || (cmp == 0 && oid->include) : cmp == 0) {
+				poemgr_snmp_port_value(ctx, port, column, value);
+				return 1;
+			}
+		}
+	}
+
+	for (int column = PETH_MAIN_PSE_POWER; column < __PETH_MAIN_PSE_COLUMN_MAX; column++) {
+		poemgr_snmp_oid_set(found, peth_main_pse_table, PETH_MAIN_PSE_TABLE_LEN, column,
+				    PETH_PSE_GROUP_INDEX, 0);
+
+		cmp = poemgr_snmp_oid_cmp(found, oid);
+		if (next ? cmp > 0 || (cmp == 0 && oid->include) : cmp == 0) {
+			poemgr_snmp_main_value(ctx, column, value);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* Returns 1 if oid is an instance below a column of one of the tables */
+static int poemgr_snmp_known_column(const struct poemgr_snmp_oid *oid)
+{
+	const uint32_t *table = peth_pse_port_table;
+	int table_len = PETH_PSE_PORT_TABLE_LEN;
+	int min_column = PETH_PSE_PORT_ADMIN_ENABLE, max_column = __PETH_PSE_PORT_COLUMN_MAX;
+
+	if (oid->len > PETH_MAIN_PSE_TABLE_LEN &&
+	    !memcmp(oid->sub, peth_main_pse_table, sizeof(peth_main_pse_table))) {
+		table = peth_main_pse_table;
+		table_len = PETH_MAIN_PSE_TABLE_LEN;
+		min_column = PETH_MAIN_PSE_POWER;
+		max_column = __PETH_MAIN_PSE_COLUMN_MAX;
+	}
+
+	/* Table, entry, column and at least one index */
+	if (oid->len < table_len + 3 || memcmp(oid->sub, table, table_len * sizeof(uint32_t)))
+		return 0;
+
+	return oid->sub[table_len] == 1 &&
+	       oid->sub[table_len + 1] >= (uint32_t) min_column && oid->sub[table_len + 1] < (uint32_t) max_column;
+}
+
+/* Requests */
+
+static void poemgr_snmp_response_begin(struct poemgr_snmp_pdu *pdu, uint16_t error, uint16_t index)
+{
+	struct poemgr_snmp_writer *w = &poemgr_snmp_tx;
+
+	poemgr_snmp_put_header(w, AGENTX_RESPONSE_PDU, pdu->transaction_id, pdu->packet_id);
+	/* sysUpTime, filled in by the master */
+	poemgr_snmp_put_u32(w, 0);
+	poemgr_snmp_put_u16(w, error);
+	poemgr_snmp_put_u16(w, index);
+}
+
+/* Returns 0 at the end of the MIB view */
+static int poemgr_snmp_get_next(struct poemgr_ctx *ctx, const struct poemgr_snmp_oid *start,
+				const struct poemgr_snmp_oid *end, struct poemgr_snmp_oid *found)
+{
+	struct poemgr_snmp_value value;
+
+	if (!poemgr_snmp_find(ctx, start, 1, found, &value) || (end->len && poemgr_snmp_oid_cmp(found, end) >= 0)) {
+		*found = *start;
+		value.type = AGENTX_END_OF_MIB_VIEW;
+	}
+
+	poemgr_snmp_put_varbind(&poemgr_snmp_tx, found, &value);
+
+	return value.type != AGENTX_END_OF_MIB_VIEW;
+}
+
+static int poemgr_snmp_get(struct poemgr_ctx *ctx, struct poemgr_snmp_pdu *pdu, struct poemgr_snmp_reader *r)
+{
+	struct poemgr_snmp_oid start, end, found;
+	struct poemgr_snmp_value value;
+
+	poemgr_snmp_response_begin(pdu, AGENTX_ERR_NONE, 0);
+
+	while (r->p < r->end && !r->error) {
+		poemgr_snmp_get_oid(r, &start);
+		poemgr_snmp_get_oid(r, &end);
+		if (r->error)
+			break;
+
+		if (pdu->type == AGENTX_GETNEXT_PDU) {
+			poemgr_snmp_get_next(ctx, &start, &end, &found);
+			continue;
+		}
+
+		if (!poemgr_snmp_find(ctx, &start, 0, &found, &value)) {
+			/* Known column, but no such row */
+			value.type = poemgr_snmp_known_column(&start) ? AGENTX_NO_SUCH_INSTANCE : AGENTX_NO_SUCH_OBJECT;
+		}
+
+		poemgr_snmp_put_varbind(&poemgr_snmp_tx, &start, &value);
+	}
+
+	return r->error;
+}
+
+static int poemgr_snmp_get_bulk(struct poemgr_ctx *ctx, struct poemgr_snmp_pdu *pdu, struct poemgr_snmp_reader *r)
+{
+	static struct poemgr_snmp_oid ranges[2][AGENTX_MAX_BULK_RANGES];
+	struct poemgr_snmp_writer *w = &poemgr_snmp_tx;
+	struct poemgr_snmp_oid found;
+	int non_repeaters, max_repetitions;
+	int num_ranges = 0;
+	int more;
+	size_t len;
+
+	non_repeaters = poemgr_snmp_get_u16(r);
+	max_repetitions = poemgr_snmp_get_u16(r);
+
+	while (r->p < r->end && !r->error && num_ranges < AGENTX_MAX_BULK_RANGES) {
+		poemgr_snmp_get_oid(r, &ranges[0][num_ranges]);
+		poemgr_snmp_get_oid(r, &ranges[1][num_ranges]);
+		num_ranges++;
+	}
+
+	if (r->error)
+		return 1;
+
+	poemgr_snmp_response_begin(pdu, AGENTX_ERR_NONE, 0);
+
+	for (int i = 0; i < non_repeaters && i < num_ranges; i++)
+		poemgr_snmp_get_next(ctx, &ranges[0][i], &ranges[1][i], &found);
+
+	for (int rep = 0; rep < max_repetitions; rep++) {
+		more = 0;
+
+		for (int i = non_repeaters; i < num_ranges; i++) {
+			len = w->len;
+			more |= poemgr_snmp_get_next(ctx, &ranges[0][i], &ranges[1][i], &found);
+
+			/* Return the repetitions which fit, the manager requests the rest (RFC 2741, 7.2.3.3) */
+			if (w->overflow) {
+				w->len = len;
+				w->overflow = 0;
+				return 0;
+			}
+
+			/* Continue after the returned object */
+			ranges[0][i] = found;
+			ranges[0][i].include = 0;
+		}
+
+		/* All ranges reached the end of the MIB view */
+		if (!more)
+			break;
+	}
+
+	return 0;
+}
+
+static int poemgr_snmp_test_set(struct poemgr_ctx *ctx, struct poemgr_snmp_reader *r, uint16_t *index)
+{
+	struct poemgr_snmp_set *set;
+	struct poemgr_snmp_value value;
+	struct poemgr_snmp_oid oid;
+	uint16_t type;
+
+	poemgr_snmp_num_sets = 0;
+
+	for (*index = 1; r->p < r->end; (*index)++) {
+		type = poemgr_snmp_get_u16(r);
+		poemgr_snmp_get_u16(r);
+		poemgr_snmp_get_oid(r, &oid);
+		poemgr_snmp_get_value(r, type, &value);
+		if (r->error)
+			return AGENTX_ERR_GEN;
+
+		/* Only the admin status and priority of existing ports are writable */
+		if (oid.len != PETH_PSE_PORT_TABLE_LEN + 4 ||
+		    memcmp(oid.sub, peth_pse_port_table, sizeof(peth_pse_port_table)) || oid.sub[PETH_PSE_PORT_TABLE_LEN] != 1 ||
+		    (oid.sub[PETH_PSE_PORT_TABLE_LEN + 1] != PETH_PSE_PORT_ADMIN_ENABLE &&
+		     oid.sub[PETH_PSE_PORT_TABLE_LEN + 1] != PETH_PSE_PORT_POWER_PRIORITY) ||
+		    oid.sub[PETH_PSE_PORT_TABLE_LEN + 2] != PETH_PSE_GROUP_INDEX ||
+		    oid.sub[PETH_PSE_PORT_TABLE_LEN + 3] < 1 || oid.sub[PETH_PSE_PORT_TABLE_LEN + 3] > (uint32_t) poemgr_profile_num_ports(ctx) ||
+		    poemgr_snmp_num_sets >= (int) (sizeof(poemgr_snmp_sets) / sizeof(poemgr_snmp_sets[0])))
+			return AGENTX_ERR_NOT_WRITABLE;
+
+		if (type != AGENTX_INTEGER)
+			return AGENTX_ERR_WRONG_TYPE;
+
+		set = &poemgr_snmp_sets[poemgr_snmp_num_sets++];
+		set->column = oid.sub[PETH_PSE_PORT_TABLE_LEN + 1];
+		set->port = oid.sub[PETH_PSE_PORT_TABLE_LEN + 3] - 1;
+		set->value = value.num;
+
+		if (set->column == PETH_PSE_PORT_ADMIN_ENABLE) {
+			if (value.num != PETH_TRUE && value.num != PETH_FALSE)
+				return AGENTX_ERR_WRONG_VALUE;
+
+			/* Ports without configuration can't be enabled */
+			if (value.num == PETH_TRUE && !ctx->ports[set->port].settings.name)
+				return AGENTX_ERR_INCONSISTENT_VALUE;
+		} else if (value.num < PETH_PRIORITY_CRITICAL || value.num > PETH_PRIORITY_LOW) {
+			return AGENTX_ERR_WRONG_VALUE;
+		}
+	}
+
+	*index = 0;
+	return AGENTX_ERR_NONE;
+}
+
+/* Switch a port as configured. Without the staggered bring-up of apply, the reply must not wait. */
+static int poemgr_snmp_switch_port(struct poemgr_ctx *ctx, int port)
+{
+	struct poemgr_port_settings *settings = &ctx->ports[port].settings;
+	int enable = settings->name && !settings->disabled && !poemgr_thermal_port_shed(ctx, port);
+
+	if (!poemgr_profile_has_cb(ctx, set_ports_power))
+		return poemgr_apply_start(ctx);
+
+	return poemgr_profile_cb(ctx, set_ports_power)(ctx, 1 << port, enable);
+}
+
+/* Switch the ports of admin status sets, priority sets don't need the PSE */
+static int poemgr_snmp_switch_ports(struct poemgr_ctx *ctx)
+{
+	int switched = 0;
+	int ret = 0;
+
+	for (int i = 0; i < poemgr_snmp_num_sets; i++) {
+		if (poemgr_snmp_sets[i].column != PETH_PSE_PORT_ADMIN_ENABLE)
+			continue;
+
+		if (poemgr_snmp_switch_port(ctx, poemgr_snmp_sets[i].port))
+			ret = 1;
+		switched = 1;
+	}
+
+	if (switched)
+		poemgr_daemon_refresh(ctx);
+
+	return ret;
+}
+
+static int poemgr_snmp_commit_set(struct poemgr_ctx *ctx)
+{
+	struct poemgr_port_settings *settings;
+	struct poemgr_snmp_set *set;
+
+	for (int i = 0; i < poemgr_profile_num_ports(ctx); i++)
+		poemgr_snmp_undo[i] = ctx->ports[i].settings;
+
+	for (int i = 0; i < poemgr_snmp_num_sets; i++) {
+		set = &poemgr_snmp_sets[i];
+		settings = &ctx->ports[set->port].settings;
+
+		if (set->column == PETH_PSE_PORT_ADMIN_ENABLE) {
+			settings->disabled = set->value == PETH_FALSE;
+		} else {
+			if (set->value == PETH_PRIORITY_CRITICAL)
+				settings->priority = POEMGR_PORT_PRIORITY_CRITICAL;
+			else if (set->value == PETH_PRIORITY_HIGH)
+				settings->priority = POEMGR_PORT_PRIORITY_HIGH;
+			else
+				settings->priority = POEMGR_PORT_PRIORITY_LOW;
+			settings->priority_set = 1;
+		}
+	}
+
+	return poemgr_snmp_switch_ports(ctx) ? AGENTX_ERR_COMMIT_FAILED : AGENTX_ERR_NONE;
+}
+
+static int poemgr_snmp_undo_set(struct poemgr_ctx *ctx)
+{
+	for (int i = 0; i < poemgr_profile_num_ports(ctx); i++)
+		ctx->ports[i].settings = poemgr_snmp_undo[i];
+
+	return poemgr_snmp_switch_ports(ctx) ? AGENTX_ERR_UNDO_FAILED : AGENTX_ERR_NONE;
+}
+
+static int poemgr_snmp_request(struct poemgr_ctx *ctx, struct poemgr_snmp_pdu *pdu)
+{
+	struct poemgr_snmp_reader r = {
+		.p = pdu->payload,
+		.end = pdu->payload + pdu->len,
+		.nbo = !!(pdu->flags & AGENTX_FLAG_NETWORK_BYTE_ORDER),
+	};
+	uint16_t index = 0;
+	int error;
+
+	switch (pdu->type) {
+		case AGENTX_GET_PDU:
+		case AGENTX_GETNEXT_PDU:
+			if (poemgr_snmp_get(ctx, pdu, &r))
+				poemgr_snmp_response_begin(pdu, AGENTX_ERR_GEN, 0);
+			break;
+		case AGENTX_GETBULK_PDU:
+			if (poemgr_snmp_get_bulk(ctx, pdu, &r))
+				poemgr_snmp_response_begin(pdu, AGENTX_ERR_GEN, 0);
+			break;
+		case AGENTX_TESTSET_PDU:
+			error = poemgr_snmp_test_set(ctx, &r, &index);
+			poemgr_snmp_response_begin(pdu, error, index);
+			break;
+		case AGENTX_COMMITSET_PDU:
+			poemgr_snmp_response_begin(pdu, poemgr_snmp_commit_set(ctx), 0);
+			break;
+		case AGENTX_UNDOSET_PDU:
+			poemgr_snmp_response_begin(pdu, poemgr_snmp_undo_set(ctx), 0);
+			break;
+		case AGENTX_CLEANUPSET_PDU:
+			/* Not acknowledged */
+			poemgr_snmp_num_sets = 0;
+			return 0;
+		case AGENTX_CLOSE_PDU:
+			return 1;
+		case AGENTX_RESPONSE_PDU:
+			/* Unsolicited */
+			return 0;
+		default:
+			poemgr_snmp_response_begin(pdu, AGENTX_ERR_GEN, 0);
+			break;
+	}
+
+	return poemgr_snmp_send(&poemgr_snmp_tx);
+}
+
+/* Connection */
+
+static int poemgr_snmp_recv_all(void *buf, size_t len, int timeout)
+{
+	struct pollfd pfd = {
+		.fd = poemgr_snmp_sock,
+		.events = POLLIN,
+	};
+	size_t received = 0;
+	ssize_t ret;
+
+	while (received < len) {
+		ret = poll(&pfd, 1, timeout);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return 1;
+
+		ret = recv(poemgr_snmp_sock, (uint8_t *) buf + received, len - received, 0);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return 1;
+
+		received += ret;
+	}
+
+	return 0;
+}
+
+static int poemgr_snmp_recv(struct poemgr_snmp_pdu *pdu, int timeout)
+{
+	uint8_t header[AGENTX_HEADER_LEN];
+	struct poemgr_snmp_reader r = {
+		.p = &header[4],
+		.end = header + sizeof(header),
+	};
+
+	if (poemgr_snmp_recv_all(header, sizeof(header), timeout))
+		return 1;
+
+	if (header[0] != AGENTX_VERSION)
+		return 1;
+
+	pdu->type = header[1];
+	pdu->flags = header[2];
+	r.nbo = !!(pdu->flags & AGENTX_FLAG_NETWORK_BYTE_ORDER);
+	pdu->session_id = poemgr_snmp_get_u32(&r);
+	pdu->transaction_id = poemgr_snmp_get_u32(&r);
+	pdu->packet_id = poemgr_snmp_get_u32(&r);
+	pdu->len = poemgr_snmp_get_u32(&r);
+
+	if (pdu->len > AGENTX_MAX_PAYLOAD || pdu->len % 4)
+		return 1;
+
+	return poemgr_snmp_recv_all(pdu->payload, pdu->len, timeout);
+}
+
+/* Sends the PDU in poemgr_snmp_tx and waits for the response. Returns the AgentX error or -1. */
+static int poemgr_snmp_transact(uint32_t packet_id)
+{
+	struct poemgr_snmp_pdu *pdu = &poemgr_snmp_rx;
+	struct poemgr_snmp_reader r;
+
+	if (poemgr_snmp_send(&poemgr_snmp_tx))
+		return -1;
+
+	do {
+		if (poemgr_snmp_recv(pdu, AGENTX_TIMEOUT))
+			return -1;
+	} while (pdu->type != AGENTX_RESPONSE_PDU || pdu->packet_id != packet_id);
+
+	r.p = pdu->payload;
+	r.end = pdu->payload + pdu->len;
+	r.nbo = !!(pdu->flags & AGENTX_FLAG_NETWORK_BYTE_ORDER);
+	r.error = 0;
+
+	/* sysUpTime */
+	poemgr_snmp_get_u32(&r);
+
+	return r.error ? -1 : poemgr_snmp_get_u16(&r);
+}
+
+static int poemgr_snmp_register(const uint32_t *subtree, int len)
+{
+	struct poemgr_snmp_writer *w = &poemgr_snmp_tx;
+	uint8_t buf[4] = {
+		0,	/* Default timeout */
+		127,	/* Default priority */
+		0,	/* No range */
+		0,
+	};
+	uint32_t packet_id = ++poemgr_snmp_packet_id;
+
+	poemgr_snmp_put_header(w, AGENTX_REGISTER_PDU, 0, packet_id);
+	poemgr_snmp_put(w, buf, sizeof(buf));
+	poemgr_snmp_put_oid(w, subtree, len, 0);
+
+	return poemgr_snmp_transact(packet_id);
+}
+
+static void poemgr_snmp_close(void)
+{
+	if (poemgr_snmp_sock < 0)
+		return;
+
+	close(poemgr_snmp_sock);
+	poemgr_snmp_sock = -1;
+	poemgr_snmp_num_sets = 0;
+	poemgr_snmp_next_connect = poemgr_time_ms() + AGENTX_RECONNECT_INTERVAL;
+}
+
+static int poemgr_snmp_connect(void)
+{
+	struct sockaddr_un addr = {
+		.sun_family = AF_UNIX,
+	};
+	struct poemgr_snmp_writer *w = &poemgr_snmp_tx;
+	uint8_t buf[4] = {};
+	uint32_t packet_id;
+
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", poemgr_snmp_path);
+
+	poemgr_snmp_sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (poemgr_snmp_sock < 0)
+		return 1;
+
+	if (connect(poemgr_snmp_sock, (struct sockaddr *) &addr, sizeof(addr)))
+		goto err;
+
+	/* Open session, the master assigns the session id */
+	poemgr_snmp_session_id = 0;
+	packet_id = ++poemgr_snmp_packet_id;
+	poemgr_snmp_put_header(w, AGENTX_OPEN_PDU, 0, packet_id);
+	poemgr_snmp_put(w, buf, sizeof(buf));
+	poemgr_snmp_put_oid(w, NULL, 0, 0);
+	poemgr_snmp_put_octets(w, "poemgr");
+
+	if (poemgr_snmp_transact(packet_id))
+		goto err;
+
+	poemgr_snmp_session_id = poemgr_snmp_rx.session_id;
+
+	if (poemgr_snmp_register(peth_pse_port_table, PETH_PSE_PORT_TABLE_LEN) ||
+	    poemgr_snmp_register(peth_main_pse_table, PETH_MAIN_PSE_TABLE_LEN))
+		goto err;
+
+	poemgr_snmp_warned = 0;
+	return 0;
+
+err:
+	if (!poemgr_snmp_warned)
+		fprintf(stderr, "Failed to connect to AgentX master %s\n", poemgr_snmp_path);
+	poemgr_snmp_warned = 1;
+
+	poemgr_snmp_close();
+	return 1;
+}
+
+int poemgr_snmp_init(struct poemgr_ctx *ctx, const char *path)
+{
+	poemgr_snmp_poemgr_ctx = ctx;
+	poemgr_snmp_path = path ? path : POEMGR_SNMP_AGENTX_SOCKET;
+
+	/* The master agent may be started later, retried from the daemon loop */
+	poemgr_snmp_connect();
+
+	return 0;
+}
+
+void poemgr_snmp_done(void)
+{
+	struct poemgr_snmp_writer *w = &poemgr_snmp_tx;
+	uint8_t buf[4] = { AGENTX_ERR_CLOSE_SHUTDOWN };
+
+	if (poemgr_snmp_sock < 0)
+		return;
+
+	poemgr_snmp_put_header(w, AGENTX_CLOSE_PDU, 0, ++poemgr_snmp_packet_id);
+	poemgr_snmp_put(w, buf, sizeof(buf));
+	poemgr_snmp_send(w);
+
+	poemgr_snmp_close();
+}
+
+int poemgr_snmp_fd(void)
+{
+	if (poemgr_snmp_sock < 0 && poemgr_snmp_path && poemgr_time_ms() >= poemgr_snmp_next_connect)
+		poemgr_snmp_connect();
+
+	return poemgr_snmp_sock;
+}
+
+void poemgr_snmp_handle(void)
+{
+	if (poemgr_snmp_sock < 0)
+		return;
+
+	if (poemgr_snmp_recv(&poemgr_snmp_rx, AGENTX_TIMEOUT) ||
+	    poemgr_snmp_request(poemgr_snmp_poemgr_ctx, &poemgr_snmp_rx)) {
+		fprintf(stderr, "AgentX session closed\n");
+		poemgr_snmp_close();
+	}
+}
+
+void poemgr_snmp_notify_port(struct poemgr_ctx *ctx, int port, struct poemgr_port_status *old_status)
+{
+	struct poemgr_port_status *status = &ctx->ports[port].status;
+	struct poemgr_snmp_port_counters *counters = &poemgr_snmp_counters[port];
+	int raised = status->faults & ~old_status->faults;
+
+	/* PD disconnected while the port stayed enabled */
+	if (old_status->active && !status->active && status->enabled)
+		counters->mps_absent++;
+
+	if (raised & POEMGR_SNMP_FAULTS_SIGNATURE)
+		counters->invalid_signature++;
+
+	if (raised & POEMGR_FAULT_TYPE_POWER_MANAGEMENT)
+		counters->power_denied++;
+
+	if (raised & POEMGR_FAULT_TYPE_OVER_CURRENT)
+		counters->overload++;
+
+	if (raised & POEMGR_FAULT_TYPE_SHORT_CIRCUIT)
+		counters->shorts++;
+}
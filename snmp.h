@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include "poemgr.h"
+
+#define POEMGR_SNMP_AGENTX_SOCKET	"/var/agentx/master"
+
+#ifdef POEMGR_SNMP
+
+/* path: AgentX master socket, NULL for the default */
+int poemgr_snmp_init(struct poemgr_ctx *ctx, const char *path);
+
+void poemgr_snmp_done(void);
+
+/* Socket to wait on for requests of the master agent, -1 if not connected */
+int poemgr_snmp_fd(void);
+
+void poemgr_snmp_handle(void);
+
+/* Update the port counters on a port state transition */
+void poemgr_snmp_notify_port(struct poemgr_ctx *ctx, int port, struct poemgr_port_status *old_status);
+
+#else
+
+static inline int poemgr_snmp_init(struct poemgr_ctx *ctx, const char *path)
+{
+	return 0;
+}
+
+static inline void poemgr_snmp_done(void)
+{
+}
+
+static inline int poemgr_snmp_fd(void)
+{
+	return -1;
+}
+
+static inline void poemgr_snmp_handle(void)
+{
+}
+
+static inline void poemgr_snmp_notify_port(struct poemgr_ctx *ctx, int port, struct poemgr_port_status *old_status)
+{
+}
+
+#endif
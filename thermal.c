@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "thermal.h"
+
+/**
+ * The daemon tracks the smoothed temperature of the hottest PSE chip.
+ * Exceeding thermal_derate_temp lowers the power limit of all ports,
+ * exceeding thermal_shed_temp additionally shuts down ports configured with
+ * low priority.
+ * Each level is left once the temperature dropped thermal_hysteresis
+ * below its threshold, so ports are not toggled around a threshold.
+ */
+
+static int poemgr_thermal_hysteresis(struct poemgr_ctx *ctx)
+{
+	if (ctx->settings.thermal_hysteresis >= 0)
+		return ctx->settings.thermal_hysteresis;
+
+	return POEMGR_THERMAL_HYSTERESIS;
+}
+
+/* Threshold of a level in degrees Celsius, 0 if the level is disabled */
+static int poemgr_thermal_threshold(struct poemgr_ctx *ctx, enum poemgr_thermal_level level)
+{
+	int temp = 0;
+
+	if (level == POEMGR_THERMAL_LEVEL_DERATE)
+		temp = ctx->settings.thermal_derate_temp;
+	else if (level == POEMGR_THERMAL_LEVEL_SHED)
+		temp = ctx->settings.thermal_shed_temp;
+
+	return temp > 0 ? temp : 0;
+}
+
+/* Temperature of the hottest chip */
+static int poemgr_thermal_read(struct poemgr_ctx *ctx, int *temp)
+{
+	struct poemgr_metric *metric;
+	int found = 0;
+
+	for (int i = 0; i < ctx->profile->num_pse_chips; i++) {
+		for (int j = 0; j < ctx->pse_status[i].num_metrics; j++) {
+			metric = &ctx->pse_status[i].metrics[j];
+
+			if (metric->type != POEMGR_METRIC_INT32 || strcmp(metric->name, "temperature"))
+				continue;
+
+			if (!found || metric->val_int32 > *temp)
+				*temp = metric->val_int32;
+			found = 1;
+		}
+	}
+
+	return found ? 0 : -1;
+}
+
+int poemgr_thermal_update(struct poemgr_ctx *ctx)
+{
+	struct poemgr_thermal *thermal = &ctx->thermal;
+	enum poemgr_thermal_level level, raise = POEMGR_THERMAL_LEVEL_NORMAL, hold = POEMGR_THERMAL_LEVEL_NORMAL;
+	int hysteresis = poemgr_thermal_hysteresis(ctx) * 1000;
+	int sample, threshold;
+
+	if (poemgr_thermal_read(ctx, &sample))
+		return 0;
+
+	/* Milli-degrees, so the average does not get stuck due to rounding */
+	sample *= 1000;
+
+	if (!thermal->valid) {
+		thermal->temperature = sample;
+		thermal->valid = 1;
+	} else {
+		thermal->temperature += (sample - thermal->temperature) >> POEMGR_THERMAL_EWMA_SHIFT;
+	}
+
+	for (level = POEMGR_THERMAL_LEVEL_DERATE; level <= POEMGR_THERMAL_LEVEL_SHED; level++) {
+		threshold = poemgr_thermal_threshold(ctx, level) * 1000;
+		if (!threshold)
+			continue;
+
+		if (thermal->temperature >= threshold)
+			raise = level;
+		if (thermal->temperature >= threshold - hysteresis)
+			hold = level;
+	}
+
+	/* Enter levels at their threshold, leave them below threshold - hysteresis */
+	level = thermal->level < hold ? thermal->level : hold;
+	if (raise > level)
+		level = raise;
+
+	if (level == thermal->level)
+		return 0;
+
+	fprintf(stderr, "Temperature %d C, thermal level %s -> %s\n", thermal->temperature / 1000,
+		poemgr_thermal_level_to_string(thermal->level), poemgr_thermal_level_to_string(level));
+
+	thermal->level = level;
+
+	return 1;
+}
+
+int poemgr_thermal_port_power_limit(struct poemgr_ctx *ctx, int port, int limit)
+{
+	int percent = ctx->settings.thermal_derate_limit;
+
+	if (ctx->thermal.level < POEMGR_THERMAL_LEVEL_DERATE)
+		return limit;
+
+	if (percent < 0 || percent > 100)
+		percent = POEMGR_THERMAL_DERATE_LIMIT;
+
+	return limit * percent / 100;
+}
+
+int poemgr_thermal_port_shed(struct poemgr_ctx *ctx, int port)
+{
+	struct poemgr_port_settings *settings = &ctx->ports[port].settings;
+
+	/* Ports without a configured priority are never shed */
+	return ctx->thermal.level == POEMGR_THERMAL_LEVEL_SHED && settings->priority_set &&
+	       settings->priority == POEMGR_PORT_PRIORITY_LOW;
+}
+
+const char *poemgr_thermal_level_to_string(enum poemgr_thermal_level level)
+{
+	switch (level) {
+		case POEMGR_THERMAL_LEVEL_NORMAL:
+			return "normal";
+		case POEMGR_THERMAL_LEVEL_DERATE:
+			return "derate";
+		case POEMGR_THERMAL_LEVEL_SHED:
+			return "shed";
+		default:
+			return "unknown";
+	}
+}
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include "poemgr.h"
+
+/* Defaults for unset options */
+#define POEMGR_THERMAL_HYSTERESIS	5	/* Degrees Celsius */
+#define POEMGR_THERMAL_DERATE_LIMIT	50	/* Percent of the port power limit */
+
+/* Weight of a new sample in the smoothed temperature: 1 / (1 << shift) */
+#define POEMGR_THERMAL_EWMA_SHIFT	2
+
+/* Update the smoothed chip temperature. Returns 1 if the derating level changed. */
+int poemgr_thermal_update(struct poemgr_ctx *ctx);
+
+/* Port power limit after derating */
+int poemgr_thermal_port_power_limit(struct poemgr_ctx *ctx, int port, int limit);
+
+/* Port has to be shut down to shed load */
+int poemgr_thermal_port_shed(struct poemgr_ctx *ctx, int port);
+
+const char *poemgr_thermal_level_to_string(enum poemgr_thermal_level level);
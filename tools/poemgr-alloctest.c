@@ -0,0 +1,266 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "poemgr.h"
+#include "arena.h"
+#include "cache.h"
+#include "scheduler.h"
+#include "smbus.h"
+
+/**
+ * Counts heap allocations of the daemon refresh path and of configuration
+ * reloads against the simulated PSE.
+ *
+ * malloc() and friends are interposed and forwarded to the glibc allocator.
+ * After a warm-up, the profile is polled for a number of refresh iterations
+ * (every port and the PSE status due each time), and reloaded with
+ * poemgr_reload() for a number of configuration generations. The
+ * configuration is read from a cache written to a temporary directory, so
+ * libuci is not involved. Neither may allocate. Building and writing the
+ * status JSON on changes is not covered, json-c allocates its objects.
+ *
+ * Finally, a reload failing with a changed profile has to leave the profile
+ * shut down, so ending it afterwards does nothing.
+ */
+
+#ifndef POEMGR_SIM
+#error "Build with make SIM=1 alloctest"
+#endif
+
+#define ALLOCTEST_WARMUP		16
+#define ALLOCTEST_REFRESHES		10000
+#define ALLOCTEST_GENERATIONS		100
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static int alloctest_counting;
+static uint64_t alloctest_allocs;
+
+void *malloc(size_t size)
+{
+	if (alloctest_counting)
+		alloctest_allocs++;
+
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	if (alloctest_counting)
+		alloctest_allocs++;
+
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	if (alloctest_counting)
+		alloctest_allocs++;
+
+	return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+	__libc_free(ptr);
+}
+
+#ifdef POEMGR_PROFILE
+#define _alloctest_profile_struct(profile)	poemgr_profile_##profile
+#define alloctest_profile_struct(profile)	_alloctest_profile_struct(profile)
+
+extern struct poemgr_profile alloctest_profile_struct(POEMGR_PROFILE);
+#define alloctest_profile			(&alloctest_profile_struct(POEMGR_PROFILE))
+#else
+extern struct poemgr_profile poemgr_profile_uswflex;
+#define alloctest_profile			(&poemgr_profile_uswflex)
+#endif
+
+static char *alloctest_port_names[] = { "lan1", "lan2", "lan3", "lan4" };
+
+static char alloctest_dir[] = "/tmp/poemgr-alloctest.XXXXXX";
+static char alloctest_config_file[PATH_MAX];
+static char alloctest_config_delta_file[PATH_MAX];
+static char alloctest_cache_file[PATH_MAX];
+
+/* Configuration file the cache is derived from, only its identity is checked */
+static int alloctest_setup(void)
+{
+	FILE *f;
+
+	if (!mkdtemp(alloctest_dir)) {
+		perror(alloctest_dir);
+		return 1;
+	}
+
+	snprintf(alloctest_config_file, sizeof(alloctest_config_file), "%s/poemgr", alloctest_dir);
+	snprintf(alloctest_config_delta_file, sizeof(alloctest_config_delta_file), "%s/poemgr.delta", alloctest_dir);
+	snprintf(alloctest_cache_file, sizeof(alloctest_cache_file), "%s/poemgr.cache", alloctest_dir);
+
+	f = fopen(alloctest_config_file, "w");
+	if (!f) {
+		perror(alloctest_config_file);
+		return 1;
+	}
+
+	fprintf(f, "config poemgr 'settings'\n");
+	fclose(f);
+
+	poemgr_cache_config_file = alloctest_config_file;
+	poemgr_cache_config_delta_file = alloctest_config_delta_file;
+	poemgr_cache_file = alloctest_cache_file;
+
+	return 0;
+}
+
+static void alloctest_cleanup(void)
+{
+	unlink(alloctest_cache_file);
+	unlink(alloctest_config_file);
+	rmdir(alloctest_dir);
+}
+
+/* Write the cache picked up by the next poemgr_reload() */
+static int alloctest_store_config(struct poemgr_ctx *ctx, const char *profile)
+{
+	struct poemgr_cache_file_id config;
+
+	/* Only sets the identity of the configuration while there is no valid cache */
+	poemgr_cache_load(ctx, &config);
+	poemgr_cache_release(ctx);
+
+	memset(&ctx->settings, 0, sizeof(ctx->settings));
+	ctx->settings.profile = (char *) profile;
+
+	for (int i = 0; i < POEMGR_MAX_PORTS; i++) {
+		memset(&ctx->ports[i].settings, 0, sizeof(ctx->ports[i].settings));
+		if (i < (int) (sizeof(alloctest_port_names) / sizeof(alloctest_port_names[0])))
+			ctx->ports[i].settings.name = alloctest_port_names[i];
+	}
+
+	if (poemgr_cache_store(ctx, &config)) {
+		fprintf(stderr, "Error writing %s\n", alloctest_cache_file);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int alloctest_refresh(struct poemgr_ctx *ctx, int64_t *now, int iterations)
+{
+	struct poemgr_sched_result result;
+
+	for (int i = 0; i < iterations; i++) {
+		/* Everything is due on every iteration */
+		*now += POEMGR_POLL_INTERVAL_MAX;
+
+		if (poemgr_sched_run(ctx, *now, &result)) {
+			fprintf(stderr, "Error refreshing status\n");
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int alloctest_generation(struct poemgr_ctx *ctx)
+{
+	if (poemgr_reload(ctx)) {
+		fprintf(stderr, "Error reloading configuration\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+static int alloctest_failed_reload(struct poemgr_ctx *ctx)
+{
+	if (alloctest_store_config(ctx, "alloctest-invalid"))
+		return 1;
+
+	if (!poemgr_reload(ctx) || ctx->profile_initialized) {
+		fprintf(stderr, "Reload with a changed profile did not fail\n");
+		return 1;
+	}
+
+	/* The failed reload already shut down the previous generation */
+	poemgr_profile_end(ctx);
+
+	/* The original configuration is picked up again */
+	if (alloctest_store_config(ctx, ctx->profile->name) || alloctest_generation(ctx))
+		return 1;
+
+	printf("%-12s %8s\n", "bad reload", "ok");
+
+	return 0;
+}
+
+static int alloctest_report(const char *name, int iterations)
+{
+	printf("%-12s %8d iterations %8llu allocations\n", name, iterations,
+	       (unsigned long long) alloctest_allocs);
+
+	return alloctest_allocs != 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static struct poemgr_ctx ctx;
+	int64_t now = 0;
+	int ret = 0;
+
+	poemgr_smbus_simulate = 1;
+
+	for (int i = 0; i < POEMGR_MAX_PORTS; i++)
+		ctx.ports[i].last_poe_class = -1;
+
+	if (alloctest_setup())
+		return 1;
+
+	if (alloctest_store_config(&ctx, alloctest_profile->name) || poemgr_reload(&ctx)) {
+		fprintf(stderr, "Error initializing profile %s\n", alloctest_profile->name);
+		alloctest_cleanup();
+		return 1;
+	}
+
+	/* First generation and first refresh may allocate (arena chunks, stdio buffers) */
+	poemgr_sched_init(&ctx, now);
+	if (alloctest_refresh(&ctx, &now, ALLOCTEST_WARMUP) || alloctest_generation(&ctx)) {
+		alloctest_cleanup();
+		return 1;
+	}
+
+	printf("Profile %s\n", ctx.profile->name);
+
+	alloctest_allocs = 0;
+	alloctest_counting = 1;
+	ret = alloctest_refresh(&ctx, &now, ALLOCTEST_REFRESHES);
+	alloctest_counting = 0;
+	ret |= alloctest_report("refresh", ALLOCTEST_REFRESHES);
+
+	alloctest_allocs = 0;
+	alloctest_counting = 1;
+	for (int i = 0; i < ALLOCTEST_GENERATIONS && !ret; i++)
+		ret = alloctest_generation(&ctx);
+	alloctest_counting = 0;
+	ret |= alloctest_report("reload", ALLOCTEST_GENERATIONS);
+
+	if (!ret)
+		ret = alloctest_failed_reload(&ctx);
+
+	poemgr_profile_end(&ctx);
+	poemgr_cache_release(&ctx);
+	poemgr_arena_free(&ctx.arena);
+	alloctest_cleanup();
+
+	return ret;
+}
@@ -0,0 +1,446 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <json.h>
+#include <libubus.h>
+#include <libubox/blobmsg_json.h>
+
+/**
+ * Load generator for the status serving path of the poemgr daemon.
+ *
+ * Every client uses its own ubus connection and calls a method of the
+ * "poemgr" object back to back. Each interval, throughput, latency
+ * percentiles, PSE bus transfers per request (from the i2c_transfers
+ * metric of the daemon) and the RSS of the daemon are printed.
+ *
+ * Run the daemon with --simulate to test without PSE hardware.
+ */
+
+#define LOADTEST_TIMEOUT		1000	/* ms */
+
+/* Log-linear latency histogram in us, ~1.5% resolution */
+#define LOADTEST_HIST_SUB_BITS		6
+#define LOADTEST_HIST_SUB		(1 << LOADTEST_HIST_SUB_BITS)
+#define LOADTEST_HIST_BUCKETS		(64 * LOADTEST_HIST_SUB)
+
+struct loadtest_hist {
+	uint64_t count[LOADTEST_HIST_BUCKETS];
+	uint64_t total;
+	uint64_t errors;
+};
+
+struct loadtest_client {
+	pthread_t thread;
+	pthread_mutex_t lock;
+
+	/* Requests since the last report */
+	struct loadtest_hist hist;
+};
+
+struct loadtest_stats {
+	int64_t time;
+	uint64_t xfers;
+	int xfers_valid;
+};
+
+static const char *loadtest_ubus_path;
+static const char *loadtest_method = "status";
+static int loadtest_num_ports = 4;
+static volatile sig_atomic_t loadtest_stop;
+
+static int64_t loadtest_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int loadtest_hist_index(uint64_t val)
+{
+	int msb;
+
+	if (val < LOADTEST_HIST_SUB)
+		return val;
+
+	msb = 63 - __builtin_clzll(val);
+
+	return (msb - LOADTEST_HIST_SUB_BITS + 1) << LOADTEST_HIST_SUB_BITS |
+	       ((val >> (msb - LOADTEST_HIST_SUB_BITS)) & (LOADTEST_HIST_SUB - 1));
+}
+
+static uint64_t loadtest_hist_value(int idx)
+{
+	int shift = idx >> LOADTEST_HIST_SUB_BITS;
+
+	if (!shift)
+		return idx;
+
+	return (uint64_t) (LOADTEST_HIST_SUB | (idx & (LOADTEST_HIST_SUB - 1))) << (shift - 1);
+}
+
+static void loadtest_hist_merge(struct loadtest_hist *dst, const struct loadtest_hist *src)
+{
+	for (int i = 0; i < LOADTEST_HIST_BUCKETS; i++)
+		dst->count[i] += src->count[i];
+
+	dst->total += src->total;
+	dst->errors += src->errors;
+}
+
+static uint64_t loadtest_hist_percentile(const struct loadtest_hist *hist, double percentile)
+{
+	uint64_t target, seen = 0;
+
+	if (!hist->total)
+		return 0;
+
+	target = hist->total * percentile;
+	if (target >= hist->total)
+		target = hist->total - 1;
+
+	for (int i = 0; i < LOADTEST_HIST_BUCKETS; i++) {
+		seen += hist->count[i];
+		if (seen > target)
+			return loadtest_hist_value(i);
+	}
+
+	return 0;
+}
+
+static void *loadtest_client_run(void *arg)
+{
+	struct loadtest_client *client = arg;
+	struct ubus_context *ubus;
+	struct blob_buf b = {};
+	int64_t start, latency;
+	uint32_t id;
+	int port = 0;
+	int ret;
+
+	ubus = ubus_connect(loadtest_ubus_path);
+	if (!ubus) {
+		fprintf(stderr, "Failed to connect to ubus\n");
+		loadtest_stop = 1;
+		return NULL;
+	}
+
+	if (ubus_lookup_id(ubus, "poemgr", &id)) {
+		fprintf(stderr, "poemgr ubus object not found, is the daemon running?\n");
+		loadtest_stop = 1;
+		goto out;
+	}
+
+	while (!loadtest_stop) {
+		blob_buf_init(&b, 0);
+		if (!strcmp(loadtest_method, "port_status")) {
+			blobmsg_add_u32(&b, "port", port);
+			port = (port + 1) % loadtest_num_ports;
+		}
+
+		start = loadtest_time_us();
+		ret = ubus_invoke(ubus, id, loadtest_method, b.head, NULL, NULL, LOADTEST_TIMEOUT);
+		latency = loadtest_time_us() - start;
+
+		pthread_mutex_lock(&client->lock);
+		if (ret) {
+			client->hist.errors++;
+		} else {
+			client->hist.count[loadtest_hist_index(latency)]++;
+			client->hist.total++;
+		}
+		pthread_mutex_unlock(&client->lock);
+	}
+
+out:
+	blob_buf_free(&b);
+	ubus_free(ubus);
+	return NULL;
+}
+
+static void loadtest_status_cb(struct ubus_request *req, int type, struct blob_attr *msg)
+{
+	struct loadtest_stats *stats = req->priv;
+	struct json_object *root_obj, *pse_arr, *pse_obj, *xfers_obj;
+	char *str;
+
+	if (!msg)
+		return;
+
+	str = blobmsg_format_json(msg, true);
+	if (!str)
+		return;
+
+	root_obj = json_tokener_parse(str);
+	free(str);
+	if (!root_obj)
+		return;
+
+	if (json_object_object_get_ex(root_obj, "pse", &pse_arr)) {
+		for (size_t i = 0; i < json_object_array_length(pse_arr); i++) {
+			pse_obj = json_object_array_get_idx(pse_arr, i);
+			if (!json_object_object_get_ex(pse_obj, "i2c_transfers", &xfers_obj))
+				continue;
+
+			stats->xfers += (uint32_t) json_object_get_int(xfers_obj);
+			stats->xfers_valid = 1;
+		}
+	}
+
+	json_object_put(root_obj);
+}
+
+static void loadtest_stats_get(struct ubus_context *ubus, uint32_t id, struct loadtest_stats *stats)
+{
+	stats->time = loadtest_time_us();
+	stats->xfers = 0;
+	stats->xfers_valid = 0;
+
+	ubus_invoke(ubus, id, "status", NULL, &loadtest_status_cb, stats, LOADTEST_TIMEOUT);
+}
+
+/* Returns the pid of a running "poemgr [...] daemon" or -1 */
+static int loadtest_find_daemon(void)
+{
+	char path[64], cmdline[256];
+	struct dirent *dirent;
+	const char *arg, *prog;
+	int pid = -1;
+	size_t len;
+	FILE *f;
+	DIR *dir;
+
+	dir = opendir("/proc");
+	if (!dir)
+		return -1;
+
+	while (pid < 0 && (dirent = readdir(dir))) {
+		if (!isdigit(dirent->d_name[0]))
+			continue;
+
+		snprintf(path, sizeof(path), "/proc/%s/cmdline", dirent->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+
+		len = fread(cmdline, 1, sizeof(cmdline) - 1, f);
+		fclose(f);
+		cmdline[len] = '\0';
+
+		prog = strrchr(cmdline, '/');
+		prog = prog ? prog + 1 : cmdline;
+		if (strcmp(prog, "poemgr"))
+			continue;
+
+		for (arg = cmdline; arg < cmdline + len; arg += strlen(arg) + 1) {
+			if (!strcmp(arg, "daemon"))
+				pid = atoi(dirent->d_name);
+		}
+	}
+
+	closedir(dir);
+	return pid;
+}
+
+/* Resident set size in kB or -1 */
+static long loadtest_rss(int pid)
+{
+	char path[64], line[128];
+	long rss = -1;
+	FILE *f;
+
+	if (pid < 0)
+		return -1;
+
+	snprintf(path, sizeof(path), "/proc/%d/status", pid);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "VmRSS: %ld kB", &rss) == 1)
+			break;
+	}
+
+	fclose(f);
+	return rss;
+}
+
+static void loadtest_report(const char *label, const struct loadtest_hist *hist,
+			    const struct loadtest_stats *from, const struct loadtest_stats *to, int pid)
+{
+	double seconds = (to->time - from->time) / 1e6;
+	long rss = loadtest_rss(pid);
+
+	printf("%-8s %10.1f req/s  p50 %6lu us  p99 %6lu us  p999 %6lu us  errors %lu",
+	       label, seconds > 0 ? hist->total / seconds : 0,
+	       (unsigned long) loadtest_hist_percentile(hist, 0.5),
+	       (unsigned long) loadtest_hist_percentile(hist, 0.99),
+	       (unsigned long) loadtest_hist_percentile(hist, 0.999),
+	       (unsigned long) hist->errors);
+
+	if (from->xfers_valid && to->xfers_valid && hist->total)
+		printf("  xfers/req %.4f", (double) (uint32_t) (to->xfers - from->xfers) / hist->total);
+
+	if (rss >= 0)
+		printf("  rss %ld kB", rss);
+
+	printf("\n");
+	fflush(stdout);
+}
+
+static void loadtest_signal(int signo)
+{
+	loadtest_stop = 1;
+}
+
+static void loadtest_usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-c clients] [-d duration] [-i interval] [-m status|port_status]\n"
+			"          [-n ports] [-p daemon-pid] [-s ubus-socket]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	struct sigaction sa = {
+		.sa_handler = &loadtest_signal,
+	};
+	struct loadtest_stats start_stats, from_stats, to_stats;
+	struct loadtest_client *clients;
+	struct loadtest_hist *hist, *total_hist;
+	struct ubus_context *ubus;
+	int num_clients = 4;
+	int duration = 60;
+	int interval = 10;
+	int pid = -1;
+	int64_t end;
+	uint32_t id;
+	int ret = 1;
+	int c;
+
+	while ((c = getopt(argc, argv, "c:d:i:m:n:p:s:")) != -1) {
+		switch (c) {
+			case 'c':
+				num_clients = atoi(optarg);
+				break;
+			case 'd':
+				duration = atoi(optarg);
+				break;
+			case 'i':
+				interval = atoi(optarg);
+				break;
+			case 'm':
+				loadtest_method = optarg;
+				break;
+			case 'n':
+				loadtest_num_ports = atoi(optarg);
+				break;
+			case 'p':
+				pid = atoi(optarg);
+				break;
+			case 's':
+				loadtest_ubus_path = optarg;
+				break;
+			default:
+				loadtest_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (num_clients < 1 || duration < 0 || interval < 1 || loadtest_num_ports < 1 ||
+	    (strcmp(loadtest_method, "status") && strcmp(loadtest_method, "port_status"))) {
+		loadtest_usage(argv[0]);
+		return 1;
+	}
+
+	if (pid < 0)
+		pid = loadtest_find_daemon();
+
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+
+	ubus = ubus_connect(loadtest_ubus_path);
+	if (!ubus) {
+		fprintf(stderr, "Failed to connect to ubus\n");
+		return 1;
+	}
+
+	if (ubus_lookup_id(ubus, "poemgr", &id)) {
+		fprintf(stderr, "poemgr ubus object not found, is the daemon running?\n");
+		goto out_ubus;
+	}
+
+	clients = calloc(num_clients, sizeof(*clients));
+	hist = calloc(1, sizeof(*hist));
+	total_hist = calloc(1, sizeof(*total_hist));
+	if (!clients || !hist || !total_hist) {
+		fprintf(stderr, "Error allocating clients\n");
+		goto out_free;
+	}
+
+	printf("%d clients calling poemgr %s, daemon pid %d\n", num_clients, loadtest_method, pid);
+
+	loadtest_stats_get(ubus, id, &start_stats);
+	from_stats = start_stats;
+	end = duration ? start_stats.time + (int64_t) duration * 1000000 : 0;
+
+	for (int i = 0; i < num_clients; i++) {
+		pthread_mutex_init(&clients[i].lock, NULL);
+		if (pthread_create(&clients[i].thread, NULL, &loadtest_client_run, &clients[i])) {
+			fprintf(stderr, "Error starting client\n");
+			loadtest_stop = 1;
+			num_clients = i;
+			break;
+		}
+	}
+
+	while (!loadtest_stop) {
+		/* Cut short by signals */
+		sleep(interval);
+
+		loadtest_stats_get(ubus, id, &to_stats);
+
+		memset(hist, 0, sizeof(*hist));
+		for (int i = 0; i < num_clients; i++) {
+			pthread_mutex_lock(&clients[i].lock);
+			loadtest_hist_merge(hist, &clients[i].hist);
+			memset(&clients[i].hist, 0, sizeof(clients[i].hist));
+			pthread_mutex_unlock(&clients[i].lock);
+		}
+		loadtest_hist_merge(total_hist, hist);
+
+		loadtest_report("interval", hist, &from_stats, &to_stats, pid);
+		from_stats = to_stats;
+
+		if (end && to_stats.time >= end)
+			loadtest_stop = 1;
+	}
+
+	for (int i = 0; i < num_clients; i++) {
+		pthread_join(clients[i].thread, NULL);
+		pthread_mutex_destroy(&clients[i].lock);
+	}
+
+	loadtest_report("total", total_hist, &start_stats, &from_stats, pid);
+	ret = 0;
+
+out_free:
+	free(total_hist);
+	free(hist);
+	free(clients);
+out_ubus:
+	ubus_free(ubus);
+	return ret;
+}
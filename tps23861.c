@@ -0,0 +1,404 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+#include "tps23861.h"
+
+static struct tps23861_priv *tps23861_priv(struct poemgr_pse_chip *pse_chip) {
+	return (struct tps23861_priv *) pse_chip->priv;
+}
+
+static int tps23861_rr(struct poemgr_pse_chip *pse_chip, uint8_t reg)
+{
+	return poemgr_smbus_read_byte(&tps23861_priv(pse_chip)->bus, reg);
+}
+
+static int tps23861_reg_update(struct poemgr_pse_chip *pse_chip, uint8_t reg, uint8_t mask, uint8_t val)
+{
+	return poemgr_smbus_update(&tps23861_priv(pse_chip)->bus, reg, mask, val);
+}
+
+static void tps23861_read_plan_build(struct poemgr_smbus_read_plan *plan, uint32_t portmask, int chip)
+{
+	uint8_t needed[POEMGR_SMBUS_NUM_REGS] = {};
+
+	if (chip)
+		needed[TPS23861_REG_TEMP] = 1;
+
+	/* Reading the events clears them for all ports */
+	if (portmask) {
+		needed[TPS23861_REG_FAULT_EVENT_COR] = 1;
+		needed[TPS23861_REG_START_EVENT_COR] = 1;
+		needed[TPS23861_REG_SUPPLY_EVENT_COR] = 1;
+	}
+
+	for (int port = 0; port < TPS23861_NUM_PORTS; port++) {
+		if (!(portmask & (1 << port)))
+			continue;
+
+		needed[TPS23861_REG_STATP(port)] = 1;
+		needed[TPS23861_REG_STATPWR] = 1;
+		needed[TPS23861_REG_OPMD] = 1;
+		needed[TPS23861_REG_POLICE(port)] = 1;
+		needed[TPS23861_REG_CURRENT(port)] = 1;
+		needed[TPS23861_REG_CURRENT(port) + 1] = 1;
+		needed[TPS23861_REG_VOLTAGE(port)] = 1;
+		needed[TPS23861_REG_VOLTAGE(port) + 1] = 1;
+	}
+
+	poemgr_smbus_plan_build(plan, needed);
+}
+
+static int tps23861_event_faults(const uint8_t *regs, int port)
+{
+	int faults = 0;
+
+	if (regs[TPS23861_REG_FAULT_EVENT_COR] & TPS23861_FAULT_EVENT_ICUT(port) ||
+	    regs[TPS23861_REG_START_EVENT_COR] & (TPS23861_START_EVENT_START(port) | TPS23861_START_EVENT_ILIM(port)))
+		faults |= POEMGR_FAULT_TYPE_OVER_CURRENT;
+
+	/* Thermal shutdown switches off all ports */
+	if (regs[TPS23861_REG_SUPPLY_EVENT_COR] & TPS23861_SUPPLY_EVENT_TSD)
+		faults |= POEMGR_FAULT_TYPE_OVER_TEMPERATURE;
+
+	return faults;
+}
+
+static int tps23861_snapshot(struct poemgr_pse_chip *pse_chip, struct poemgr_pse_snapshot *snapshot,
+			     uint32_t portmask, int chip)
+{
+	struct tps23861_priv *priv = tps23861_priv(pse_chip);
+	int ret;
+
+	portmask &= (1 << TPS23861_NUM_PORTS) - 1;
+
+	snapshot->portmask = 0;
+	snapshot->chip = 0;
+
+	ret = poemgr_smbus_plan_exec(&priv->bus, &priv->port_plans[portmask], snapshot->regs);
+	if (ret)
+		return ret;
+
+	snapshot->portmask = portmask;
+
+	/* The events of the other ports were cleared as well, keep them for their next snapshot */
+	for (int port = 0; portmask && port < TPS23861_NUM_PORTS; port++)
+		priv->latched_faults[port] |= tps23861_event_faults(snapshot->regs, port);
+
+	if (chip) {
+		ret = poemgr_smbus_plan_exec(&priv->bus, &priv->chip_plan, snapshot->regs);
+		if (ret)
+			return ret;
+
+		snapshot->chip = 1;
+	}
+
+	return 0;
+}
+
+static int tps23861_reg16(const uint8_t *regs, uint8_t reg)
+{
+	return (regs[reg] | regs[reg + 1] << 8) & 0x3FFF;
+}
+
+static int tps23861_statp_faults(int statp)
+{
+	int faults = 0;
+
+	switch (TPS23861_STATP_DETECTION(statp)) {
+		case TPS23861_DETECTION_SHORT_CIRCUIT:
+			faults |= POEMGR_FAULT_TYPE_SHORT_CIRCUIT;
+			break;
+		case TPS23861_DETECTION_RSIG_TOO_LOW:
+			faults |= POEMGR_FAULT_TYPE_RESISTANCE_TOO_LOW;
+			break;
+		case TPS23861_DETECTION_RSIG_TOO_HIGH:
+			faults |= POEMGR_FAULT_TYPE_RESISTANCE_TOO_HIGH;
+			break;
+		case TPS23861_DETECTION_OPEN_CIRCUIT:
+			faults |= POEMGR_FAULT_TYPE_OPEN_CIRCUIT;
+			break;
+	}
+
+	if (TPS23861_STATP_CLASSIFICATION(statp) == TPS23861_CLASSIFICATION_OVER_CURRENT)
+		faults |= POEMGR_FAULT_TYPE_OVER_CURRENT;
+
+	return faults;
+}
+
+static int tps23861_statp_poe_class(int statp)
+{
+	int c = TPS23861_STATP_CLASSIFICATION(statp);
+
+	if (c > 0 && c < 5)
+		return c;
+
+	return c == TPS23861_CLASSIFICATION_CLASS_0 ? 0 : -1;
+}
+
+static void tps23861_port_status(struct poemgr_pse_chip *pse_chip, const struct poemgr_pse_snapshot *snapshot,
+				 int port, struct poemgr_port_status *status)
+{
+	const uint8_t *regs = snapshot->regs;
+	int64_t raw_i, raw_v;
+	int statp = regs[TPS23861_REG_STATP(port)];
+
+	raw_i = tps23861_reg16(regs, TPS23861_REG_CURRENT(port));
+	raw_v = tps23861_reg16(regs, TPS23861_REG_VOLTAGE(port));
+
+	/* nA * uV -> W */
+	status->power = raw_i * TPS23861_CURRENT_LSB_NA * raw_v * TPS23861_VOLTAGE_LSB_UV / 1000000000000000LL;
+	status->active = !!(regs[TPS23861_REG_STATPWR] & TPS23861_STATPWR_PG(port));
+	status->power_limit = regs[TPS23861_REG_POLICE(port)] / TPS23861_POLICE_PER_WATT;
+	status->enabled = ((regs[TPS23861_REG_OPMD] >> TPS23861_OPMD_SHIFT(port)) & 0x3) == TPS23861_OPMD_AUTO;
+	status->poe_class = tps23861_statp_poe_class(statp);
+
+	/* Events of faults which may have cleared before this snapshot, reported once */
+	status->latched_faults = tps23861_priv(pse_chip)->latched_faults[port];
+	tps23861_priv(pse_chip)->latched_faults[port] = 0;
+	status->faults = tps23861_statp_faults(statp) | status->latched_faults;
+}
+
+static int tps23861_device_online(struct poemgr_pse_chip *pse_chip)
+{
+	int id = tps23861_rr(pse_chip, TPS23861_REG_ID);
+
+	return id >= 0 && TPS23861_ID_MFR(id) == TPS23861_ID_MFR_TI;
+}
+
+static int tps23861_set_port_mode(struct poemgr_pse_chip *pse_chip, uint32_t portmask, enum poemgr_pse_port_mode mode)
+{
+	uint8_t opmd_mask = 0, opmd_val = 0, detena_mask = 0;
+	int opmode;
+	int ret;
+
+	opmode = mode == POEMGR_PSE_PORT_MODE_AUTO ? TPS23861_OPMD_AUTO : TPS23861_OPMD_OFF;
+
+	for (int port = 0; port < TPS23861_NUM_PORTS; port++) {
+		if (!(portmask & (1 << port)))
+			continue;
+
+		opmd_mask |= 0x3 << TPS23861_OPMD_SHIFT(port);
+		opmd_val |= opmode << TPS23861_OPMD_SHIFT(port);
+		detena_mask |= TPS23861_DETENA_PORT(port);
+	}
+
+	if (!opmd_mask)
+		return 0;
+
+	ret = tps23861_reg_update(pse_chip, TPS23861_REG_OPMD, opmd_mask, opmd_val);
+	if (ret < 0 || mode == POEMGR_PSE_PORT_MODE_OFF)
+		return ret;
+
+	/* Switching a port off clears its detection and classification enable */
+	return tps23861_reg_update(pse_chip, TPS23861_REG_DETENA, detena_mask, detena_mask);
+}
+
+static int tps23861_ports_power_good_get(struct poemgr_pse_chip *pse_chip)
+{
+	int reg_val = tps23861_rr(pse_chip, TPS23861_REG_STATPWR);
+
+	if (reg_val < 0)
+		return reg_val;
+
+	return (reg_val >> 4) & ((1 << TPS23861_NUM_PORTS) - 1);
+}
+
+static int tps23861_port_power_limit_set(struct poemgr_pse_chip *pse_chip, int port, int power_limit)
+{
+	int val = power_limit * TPS23861_POLICE_PER_WATT;
+
+	if (val > 0xFF)
+		val = 0xFF;
+
+	return poemgr_smbus_write_byte(&tps23861_priv(pse_chip)->bus, TPS23861_REG_POLICE(port), val);
+}
+
+static int tps23861_export_metric(struct poemgr_pse_chip *pse_chip, struct poemgr_metric *output, int metric)
+{
+	int val;
+
+	if (metric < 0 || metric >= pse_chip->num_metrics)
+		return -1;
+
+	if (metric == 0) {
+		val = tps23861_rr(pse_chip, TPS23861_REG_TEMP);
+		if (val < 0)
+			return -1;
+
+		output->type = POEMGR_METRIC_INT32;
+		output->name = "temperature";
+		output->val_int32 = TPS23861_TEMP_TO_C(val);
+	} else if (metric == 1) {
+		output->type = POEMGR_METRIC_INT32;
+		output->name = "i2c_errors";
+		output->val_int32 = tps23861_priv(pse_chip)->bus.xfer_errors;
+	} else if (metric == 2) {
+		output->type = POEMGR_METRIC_INT32;
+		output->name = "i2c_transfers";
+		output->val_int32 = tps23861_priv(pse_chip)->bus.xfers;
+	}
+
+	return 0;
+}
+
+static int tps23861_init(struct poemgr_pse_chip *pse_chip, struct poemgr_arena *arena, int i2c_bus, int i2c_addr,
+			 uint32_t port_mask)
+{
+	struct tps23861_priv *priv;
+
+	/* Released together with the configuration generation */
+	priv = poemgr_arena_alloc(arena, sizeof(struct tps23861_priv));
+	if (!priv)
+		return 1;
+
+	for (uint32_t mask = 0; mask < (1 << TPS23861_NUM_PORTS); mask++)
+		tps23861_read_plan_build(&priv->port_plans[mask], mask, 0);
+	tps23861_read_plan_build(&priv->chip_plan, 0, 1);
+	memset(priv->latched_faults, 0, sizeof(priv->latched_faults));
+
+	pse_chip->priv = (void *) priv;
+	pse_chip->portmask = port_mask;
+	pse_chip->model = "TPS23861";
+	/* Power is managed per port only */
+	pse_chip->num_budget_banks = 0;
+	pse_chip->num_metrics = 3;
+
+	return poemgr_smbus_open(&priv->bus, arena, pse_chip->model, i2c_bus, i2c_addr, &tps23861_sim);
+}
+
+static int tps23861_end(struct poemgr_pse_chip *pse_chip)
+{
+	/* priv is owned by the configuration arena */
+	return poemgr_smbus_close(&tps23861_priv(pse_chip)->bus);
+}
+
+const struct poemgr_pse_ops tps23861_pse_ops = {
+	.init = &tps23861_init,
+	.end = &tps23861_end,
+	.online = &tps23861_device_online,
+	.snapshot = &tps23861_snapshot,
+	.port_status = &tps23861_port_status,
+	.set_port_mode = &tps23861_set_port_mode,
+	.get_power_good = &tps23861_ports_power_good_get,
+	.set_limits = &tps23861_port_power_limit_set,
+	.export_metric = &tps23861_export_metric,
+};
+
+/* Simulator */
+
+struct tps23861_sim_state {
+	uint8_t regs[POEMGR_SMBUS_NUM_REGS];
+	struct poemgr_sim_port ports[TPS23861_NUM_PORTS];
+};
+
+static void tps23861_sim_init(void *state)
+{
+	struct tps23861_sim_state *sim = state;
+
+	memset(sim->regs, 0, sizeof(sim->regs));
+	sim->regs[TPS23861_REG_ID] = TPS23861_ID_DEFAULT;
+	sim->regs[TPS23861_REG_OPMD] = 0xFF;
+	sim->regs[TPS23861_REG_DETENA] = 0xFF;
+	sim->regs[TPS23861_REG_TEMP] = TPS23861_TEMP_FROM_C(POEMGR_SIM_TEMPERATURE);
+
+	for (int port = 0; port < TPS23861_NUM_PORTS; port++) {
+		sim->regs[TPS23861_REG_POLICE(port)] = 0xFF;
+		poemgr_sim_port_reset(&sim->ports[port]);
+	}
+}
+
+static uint8_t tps23861_sim_statp(struct tps23861_sim_state *sim, int port)
+{
+	int poe_class = poemgr_sim_pd_get(port)->poe_class;
+
+	switch (poemgr_sim_port_state(&sim->ports[port], port)) {
+		case POEMGR_SIM_PD_OPEN:
+			return TPS23861_DETECTION_OPEN_CIRCUIT;
+		case POEMGR_SIM_PD_CLASSIFYING:
+			return TPS23861_DETECTION_GOOD;
+		case POEMGR_SIM_PD_POWERING:
+		case POEMGR_SIM_PD_POWERED:
+			if (!poe_class)
+				poe_class = TPS23861_CLASSIFICATION_CLASS_0;
+			return TPS23861_DETECTION_GOOD | poe_class << 4;
+		default:
+			return 0;
+	}
+}
+
+static uint8_t tps23861_sim_statpwr(struct tps23861_sim_state *sim)
+{
+	uint8_t val = 0;
+
+	for (int port = 0; port < TPS23861_NUM_PORTS; port++) {
+		switch (poemgr_sim_port_state(&sim->ports[port], port)) {
+			case POEMGR_SIM_PD_POWERED:
+				val |= TPS23861_STATPWR_PG(port);
+				/* fallthrough */
+			case POEMGR_SIM_PD_POWERING:
+				val |= TPS23861_STATPWR_PE(port);
+				break;
+			default:
+				break;
+		}
+	}
+
+	return val;
+}
+
+static uint8_t tps23861_sim_read(void *state, uint8_t reg)
+{
+	struct tps23861_sim_state *sim = state;
+	int port, raw;
+
+	if (reg >= TPS23861_REG_STATP(0) && reg <= TPS23861_REG_STATP(TPS23861_NUM_PORTS - 1))
+		return tps23861_sim_statp(sim, reg - TPS23861_REG_STATP(0));
+
+	if (reg == TPS23861_REG_STATPWR)
+		return tps23861_sim_statpwr(sim);
+
+	if (reg >= TPS23861_REG_CURRENT(0) && reg < TPS23861_REG_CURRENT(TPS23861_NUM_PORTS)) {
+		port = (reg - TPS23861_REG_CURRENT(0)) / 4;
+		raw = 0;
+
+		if (reg < TPS23861_REG_VOLTAGE(port)) {
+			raw = (int64_t) poemgr_sim_port_current(&sim->ports[port], port) * 1000 / TPS23861_CURRENT_LSB_NA;
+		} else if (poemgr_sim_port_state(&sim->ports[port], port) == POEMGR_SIM_PD_POWERED) {
+			raw = (int64_t) POEMGR_SIM_PORT_VOLTAGE * 1000 / TPS23861_VOLTAGE_LSB_UV;
+		}
+
+		return (reg & 1) ? raw >> 8 : raw & 0xFF;
+	}
+
+	return sim->regs[reg];
+}
+
+static void tps23861_sim_write(void *state, uint8_t reg, uint8_t val)
+{
+	struct tps23861_sim_state *sim = state;
+	int opmode;
+
+	sim->regs[reg] = val;
+
+	if (reg != TPS23861_REG_OPMD && reg != TPS23861_REG_DETENA)
+		return;
+
+	for (int port = 0; port < TPS23861_NUM_PORTS; port++) {
+		opmode = (sim->regs[TPS23861_REG_OPMD] >> TPS23861_OPMD_SHIFT(port)) & 0x3;
+		if (opmode == TPS23861_OPMD_OFF)
+			sim->regs[TPS23861_REG_DETENA] &= ~TPS23861_DETENA_PORT(port);
+
+		poemgr_sim_port_enable(&sim->ports[port], opmode == TPS23861_OPMD_AUTO &&
+				       (sim->regs[TPS23861_REG_DETENA] & TPS23861_DETENA_PORT(port)));
+	}
+}
+
+const struct poemgr_smbus_sim tps23861_sim = {
+	.state_size = sizeof(struct tps23861_sim_state),
+	.init = &tps23861_sim_init,
+	.read = &tps23861_sim_read,
+	.write = &tps23861_sim_write,
+};
@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "poemgr.h"
+#include "pse.h"
+#include "smbus.h"
+
+/**
+ * See TI TPS23861 datasheet (SLUSBX9), register map
+ */
+
+#define TPS23861_NUM_PORTS		4
+
+#define TPS23861_REG_FAULT_EVENT_COR	0x07	/* Event registers, cleared by reading */
+#define TPS23861_REG_START_EVENT_COR	0x09
+#define TPS23861_REG_SUPPLY_EVENT_COR	0x0B
+#define TPS23861_REG_STATP(port)	(0x0C + (port))
+#define TPS23861_REG_STATPWR		0x10
+#define TPS23861_REG_OPMD		0x12
+#define TPS23861_REG_DETENA		0x14
+#define TPS23861_REG_ID			0x1B
+#define TPS23861_REG_POLICE(port)	(0x1E + (port))
+#define TPS23861_REG_TEMP		0x2C
+#define TPS23861_REG_CURRENT(port)	(0x30 + 4 * (port))	/* 14 bit, LSB first */
+#define TPS23861_REG_VOLTAGE(port)	(0x32 + 4 * (port))	/* 14 bit, LSB first */
+
+/* FAULT EVENT: Disconnect [7:4], ICUT [3:0] */
+#define TPS23861_FAULT_EVENT_ICUT(port)	(1 << (port))
+
+/* START EVENT: ILIM [7:4], start fault [3:0] */
+#define TPS23861_START_EVENT_START(port)	(1 << (port))
+#define TPS23861_START_EVENT_ILIM(port)	(1 << ((port) + 4))
+
+/* SUPPLY EVENT: Thermal shutdown [7] */
+#define TPS23861_SUPPLY_EVENT_TSD	0x80
+
+/* STATP: Detection [3:0] and classification [6:4], same encoding as PD69104 */
+#define TPS23861_STATP_DETECTION(v)	((v) & 0xF)
+#define TPS23861_STATP_CLASSIFICATION(v)	(((v) >> 4) & 0x7)
+
+#define TPS23861_DETECTION_SHORT_CIRCUIT	0x1
+#define TPS23861_DETECTION_RSIG_TOO_LOW		0x3
+#define TPS23861_DETECTION_GOOD			0x4
+#define TPS23861_DETECTION_RSIG_TOO_HIGH	0x5
+#define TPS23861_DETECTION_OPEN_CIRCUIT		0x6
+
+#define TPS23861_CLASSIFICATION_CLASS_0		0x6
+#define TPS23861_CLASSIFICATION_OVER_CURRENT	0x7
+
+/* STATPWR: Power enabled [3:0], power good [7:4] */
+#define TPS23861_STATPWR_PE(port)	(1 << (port))
+#define TPS23861_STATPWR_PG(port)	(1 << ((port) + 4))
+
+/* OPMD: 2 bits per port */
+#define TPS23861_OPMD_SHIFT(port)	((port) * 2)
+#define TPS23861_OPMD_OFF		0x0
+#define TPS23861_OPMD_MANUAL		0x1
+#define TPS23861_OPMD_SEMI_AUTO		0x2
+#define TPS23861_OPMD_AUTO		0x3
+
+/* DETENA: Detection [3:0], classification [7:4] */
+#define TPS23861_DETENA_PORT(port)	(0x11 << (port))
+
+/* ID: Manufacturer [7:3], IC version [2:0] */
+#define TPS23861_ID_MFR(v)		((v) >> 3)
+#define TPS23861_ID_MFR_TI		0x0A
+#define TPS23861_ID_DEFAULT		0x54
+
+/* Power policing, 0.5 W per LSB */
+#define TPS23861_POLICE_PER_WATT	2
+
+/* Temperature: -20 C + 0.652 C per LSB */
+#define TPS23861_TEMP_TO_C(v)		(-20 + (v) * 652 / 1000)
+#define TPS23861_TEMP_FROM_C(t)		(((t) + 20) * 1000 / 652)
+
+#define TPS23861_CURRENT_LSB_NA		61035	/* 61.035 uA */
+#define TPS23861_VOLTAGE_LSB_UV		3662	/* 3.662 mV */
+
+struct tps23861_priv {
+	struct poemgr_smbus bus;
+
+	/* Read plans indexed by port mask, chip-wide registers */
+	struct poemgr_smbus_read_plan port_plans[1 << TPS23861_NUM_PORTS];
+	struct poemgr_smbus_read_plan chip_plan;
+
+	/* Faults of the event registers not yet reported by port_status, per port */
+	uint16_t latched_faults[TPS23861_NUM_PORTS];
+};
+
+extern const struct poemgr_pse_ops tps23861_pse_ops;
+
+/* Register model of the chip for --simulate */
+extern const struct poemgr_smbus_sim tps23861_sim;
@@ -0,0 +1,121 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+/**
+ * Spans are recorded into a buffer allocated when tracing is enabled and
+ * written as Chrome trace-event JSON (loadable in Perfetto or
+ * chrome://tracing) when tracing is stopped.
+ */
+
+struct poemgr_trace poemgr_trace;
+
+int64_t poemgr_trace_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int poemgr_trace_open(const char *path)
+{
+	poemgr_trace.events = calloc(POEMGR_TRACE_MAX_EVENTS, sizeof(struct poemgr_trace_event));
+	if (!poemgr_trace.events)
+		return 1;
+
+	poemgr_trace.path = strdup(path);
+	if (!poemgr_trace.path) {
+		free(poemgr_trace.events);
+		poemgr_trace.events = NULL;
+		return 1;
+	}
+
+	poemgr_trace.num_events = 0;
+	poemgr_trace.max_events = POEMGR_TRACE_MAX_EVENTS;
+	poemgr_trace.dropped = 0;
+
+	return 0;
+}
+
+void poemgr_trace_record(int64_t start, const char *cat, const char *name, int num_args, ...)
+{
+	struct poemgr_trace_event *event;
+	va_list ap;
+
+	if (poemgr_trace.num_events >= poemgr_trace.max_events) {
+		poemgr_trace.dropped++;
+		return;
+	}
+
+	event = &poemgr_trace.events[poemgr_trace.num_events++];
+	event->cat = cat;
+	event->name = name;
+	event->ts = start;
+	event->dur = poemgr_trace_now() - start;
+
+	if (num_args > POEMGR_TRACE_MAX_ARGS)
+		num_args = POEMGR_TRACE_MAX_ARGS;
+
+	va_start(ap, num_args);
+	for (int i = 0; i < num_args; i++) {
+		event->arg_names[i] = va_arg(ap, const char *);
+		event->arg_vals[i] = va_arg(ap, int);
+	}
+	va_end(ap);
+
+	event->num_args = num_args;
+}
+
+static void poemgr_trace_write_event(FILE *f, struct poemgr_trace_event *event, int pid)
+{
+	fprintf(f, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":%d,\"args\":{",
+		event->name, event->cat, (long long) event->ts, (long long) event->dur, pid, pid);
+
+	for (int i = 0; i < event->num_args; i++)
+		fprintf(f, "%s\"%s\":%d", i ? "," : "", event->arg_names[i], event->arg_vals[i]);
+
+	fprintf(f, "}}");
+}
+
+int poemgr_trace_close(void)
+{
+	int pid = getpid();
+	int ret = 0;
+	FILE *f;
+
+	if (!poemgr_trace.events)
+		return 0;
+
+	f = fopen(poemgr_trace.path, "w");
+	if (!f) {
+		perror(poemgr_trace.path);
+		ret = 1;
+		goto out;
+	}
+
+	fprintf(f, "{\"traceEvents\":[\n");
+	for (int i = 0; i < poemgr_trace.num_events; i++) {
+		poemgr_trace_write_event(f, &poemgr_trace.events[i], pid);
+		fprintf(f, "%s\n", i + 1 < poemgr_trace.num_events ? "," : "");
+	}
+	fprintf(f, "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%d}}\n", poemgr_trace.dropped);
+
+	if (fclose(f))
+		ret = 1;
+
+out:
+	free(poemgr_trace.events);
+	free(poemgr_trace.path);
+	memset(&poemgr_trace, 0, sizeof(poemgr_trace));
+
+	return ret;
+}
@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include <stdint.h>
+
+#define POEMGR_TRACE_MAX_EVENTS		16384
+#define POEMGR_TRACE_MAX_ARGS		4
+
+struct poemgr_trace_event {
+	const char *cat;
+	const char *name;
+	int64_t ts;
+	int64_t dur;
+
+	int num_args;
+	const char *arg_names[POEMGR_TRACE_MAX_ARGS];
+	int arg_vals[POEMGR_TRACE_MAX_ARGS];
+};
+
+struct poemgr_trace {
+	/* NULL while tracing is disabled */
+	struct poemgr_trace_event *events;
+	int num_events;
+	int max_events;
+	int dropped;
+
+	char *path;
+};
+
+extern struct poemgr_trace poemgr_trace;
+
+int64_t poemgr_trace_now(void);
+
+int poemgr_trace_open(const char *path);
+
+int poemgr_trace_close(void);
+
+/* Arguments are num_args pairs of (const char *name, int value). Strings must be static. */
+void poemgr_trace_record(int64_t start, const char *cat, const char *name, int num_args, ...);
+
+/* Returns the start timestamp of a span, 0 when tracing is disabled */
+static inline int64_t poemgr_trace_begin(void)
+{
+	if (!poemgr_trace.events)
+		return 0;
+
+	return poemgr_trace_now();
+}
+
+#define poemgr_trace_end(start, cat, name, num_args, ...) \
+	do { \
+		if (poemgr_trace.events) \
+			poemgr_trace_record(start, cat, name, num_args, ##__VA_ARGS__); \
+	} while (0)
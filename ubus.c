@@ -0,0 +1,256 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <stdio.h>
+#include <json.h>
+#include <libubus.h>
+#include <libubox/blobmsg_json.h>
+
+#include "ubus.h"
+#include "daemon.h"
+
+/**
+ * The "poemgr" object serves the status cached by the daemon, so requests
+ * don't cause any bus traffic to the PSE. State transitions detected by the
+ * daemon are published as notifications to subscribers.
+ */
+
+static struct ubus_context *poemgr_ubus_ctx;
+static struct poemgr_ctx *poemgr_ubus_poemgr_ctx;
+static const char *poemgr_ubus_path;
+static int poemgr_ubus_connected;
+static struct blob_buf b;
+
+enum {
+	POEMGR_UBUS_PORT_STATUS_PORT,
+	__POEMGR_UBUS_PORT_STATUS_MAX,
+};
+
+static const struct blobmsg_policy poemgr_ubus_port_status_policy[] = {
+	[POEMGR_UBUS_PORT_STATUS_PORT] = { .name = "port", .type = BLOBMSG_TYPE_INT32 },
+};
+
+static int poemgr_ubus_reply_json(struct ubus_context *ctx, struct ubus_request_data *req,
+				  struct json_object *obj)
+{
+	blob_buf_init(&b, 0);
+	blobmsg_add_object(&b, obj);
+	json_object_put(obj);
+
+	return ubus_send_reply(ctx, req, b.head);
+}
+
+static int poemgr_ubus_status(struct ubus_context *ctx, struct ubus_object *obj,
+			      struct ubus_request_data *req, const char *method,
+			      struct blob_attr *msg)
+{
+	struct poemgr_ctx *poemgr_ctx = poemgr_ubus_poemgr_ctx;
+
+	poemgr_ubus_reply_json(ctx, req, poemgr_status_to_json(poemgr_ctx));
+
+	return UBUS_STATUS_OK;
+}
+
+static int poemgr_ubus_port_status(struct ubus_context *ctx, struct ubus_object *obj,
+				   struct ubus_request_data *req, const char *method,
+				   struct blob_attr *msg)
+{
+	struct poemgr_ctx *poemgr_ctx = poemgr_ubus_poemgr_ctx;
+	struct blob_attr *tb[__POEMGR_UBUS_PORT_STATUS_MAX];
+	int port;
+
+	blobmsg_parse(poemgr_ubus_port_status_policy, __POEMGR_UBUS_PORT_STATUS_MAX, tb,
+		      blob_data(msg), blob_len(msg));
+
+	if (!tb[POEMGR_UBUS_PORT_STATUS_PORT])
+		return UBUS_STATUS_INVALID_ARGUMENT;
+
+	port = blobmsg_get_u32(tb[POEMGR_UBUS_PORT_STATUS_PORT]);
+	if (port < 0 || port >= poemgr_profile_num_ports(poemgr_ctx))
+		return UBUS_STATUS_NOT_FOUND;
+
+	poemgr_ubus_reply_json(ctx, req, poemgr_port_status_to_json(poemgr_ctx, port));
+
+	return UBUS_STATUS_OK;
+}
+
+static int poemgr_ubus_apply(struct ubus_context *ctx, struct ubus_object *obj,
+			     struct ubus_request_data *req, const char *method,
+			     struct blob_attr *msg)
+{
+	struct poemgr_ctx *poemgr_ctx = poemgr_ubus_poemgr_ctx;
+	int ret;
+
+	/* Replies once the configuration is written, the daemon loop brings up the ports */
+	ret = poemgr_apply_start(poemgr_ctx);
+	poemgr_daemon_refresh(poemgr_ctx);
+
+	return ret ? UBUS_STATUS_UNKNOWN_ERROR : UBUS_STATUS_OK;
+}
+
+static int poemgr_ubus_enable(struct ubus_context *ctx, struct ubus_object *obj,
+			      struct ubus_request_data *req, const char *method,
+			      struct blob_attr *msg)
+{
+	struct poemgr_ctx *poemgr_ctx = poemgr_ubus_poemgr_ctx;
+	int ret;
+
+	ret = poemgr_enable(poemgr_ctx);
+	poemgr_daemon_refresh(poemgr_ctx);
+
+	return ret ? UBUS_STATUS_UNKNOWN_ERROR : UBUS_STATUS_OK;
+}
+
+static int poemgr_ubus_disable(struct ubus_context *ctx, struct ubus_object *obj,
+			       struct ubus_request_data *req, const char *method,
+			       struct blob_attr *msg)
+{
+	struct poemgr_ctx *poemgr_ctx = poemgr_ubus_poemgr_ctx;
+	int ret;
+
+	ret = poemgr_disable(poemgr_ctx);
+	poemgr_daemon_refresh(poemgr_ctx);
+
+	return ret ? UBUS_STATUS_UNKNOWN_ERROR : UBUS_STATUS_OK;
+}
+
+static const struct ubus_method poemgr_ubus_methods[] = {
+	UBUS_METHOD_NOARG("status", poemgr_ubus_status),
+	UBUS_METHOD("port_status", poemgr_ubus_port_status, poemgr_ubus_port_status_policy),
+	UBUS_METHOD_NOARG("apply", poemgr_ubus_apply),
+	UBUS_METHOD_NOARG("enable", poemgr_ubus_enable),
+	UBUS_METHOD_NOARG("disable", poemgr_ubus_disable),
+};
+
+static struct ubus_object_type poemgr_ubus_object_type =
+	UBUS_OBJECT_TYPE("poemgr", poemgr_ubus_methods);
+
+static struct ubus_object poemgr_ubus_object = {
+	.name = "poemgr",
+	.type = &poemgr_ubus_object_type,
+	.methods = poemgr_ubus_methods,
+	.n_methods = ARRAY_SIZE(poemgr_ubus_methods),
+};
+
+static void poemgr_ubus_connection_lost(struct ubus_context *ctx)
+{
+	/* Reconnect from the daemon loop */
+	poemgr_ubus_connected = 0;
+}
+
+int poemgr_ubus_init(struct poemgr_ctx *ctx, const char *path)
+{
+	int ret;
+
+	poemgr_ubus_poemgr_ctx = ctx;
+	poemgr_ubus_path = path;
+
+	poemgr_ubus_ctx = ubus_connect(path);
+	if (!poemgr_ubus_ctx) {
+		fprintf(stderr, "Failed to connect to ubus\n");
+		return 1;
+	}
+
+	poemgr_ubus_ctx->connection_lost = &poemgr_ubus_connection_lost;
+
+	ret = ubus_add_object(poemgr_ubus_ctx, &poemgr_ubus_object);
+	if (ret) {
+		fprintf(stderr, "Failed to add ubus object: %s\n", ubus_strerror(ret));
+		ubus_free(poemgr_ubus_ctx);
+		poemgr_ubus_ctx = NULL;
+		return 1;
+	}
+
+	poemgr_ubus_connected = 1;
+
+	return 0;
+}
+
+void poemgr_ubus_done(void)
+{
+	if (!poemgr_ubus_ctx)
+		return;
+
+	ubus_free(poemgr_ubus_ctx);
+	poemgr_ubus_ctx = NULL;
+	blob_buf_free(&b);
+}
+
+int poemgr_ubus_fd(void)
+{
+	if (!poemgr_ubus_ctx)
+		return -1;
+
+	/* Objects are registered again on reconnect */
+	if (!poemgr_ubus_connected && !ubus_reconnect(poemgr_ubus_ctx, poemgr_ubus_path))
+		poemgr_ubus_connected = 1;
+
+	if (!poemgr_ubus_connected)
+		return -1;
+
+	return poemgr_ubus_ctx->sock.fd;
+}
+
+void poemgr_ubus_handle(void)
+{
+	if (!poemgr_ubus_ctx || !poemgr_ubus_connected)
+		return;
+
+	ubus_handle_event(poemgr_ubus_ctx);
+}
+
+static void poemgr_ubus_notify(const char *type, struct json_object *obj)
+{
+	if (!poemgr_ubus_object.has_subscribers) {
+		json_object_put(obj);
+		return;
+	}
+
+	blob_buf_init(&b, 0);
+	blobmsg_add_object(&b, obj);
+	json_object_put(obj);
+
+	ubus_notify(poemgr_ubus_ctx, &poemgr_ubus_object, type, b.head, -1);
+}
+
+static struct json_object *poemgr_ubus_port_event(struct poemgr_ctx *ctx, int port)
+{
+	struct json_object *obj = poemgr_port_status_to_json(ctx, port);
+
+	json_object_object_add(obj, "port", json_object_new_int(port));
+
+	return obj;
+}
+
+void poemgr_ubus_notify_port(struct poemgr_ctx *ctx, int port, struct poemgr_port_status *old_status)
+{
+	struct poemgr_port_status *status = &ctx->ports[port].status;
+
+	if (!poemgr_ubus_ctx || !poemgr_ubus_connected)
+		return;
+
+	if (!old_status->active && status->active)
+		poemgr_ubus_notify("port.up", poemgr_ubus_port_event(ctx, port));
+	else if (old_status->active && !status->active)
+		poemgr_ubus_notify("port.down", poemgr_ubus_port_event(ctx, port));
+
+	/* Faults raised since the last refresh */
+	if (status->faults & ~old_status->faults)
+		poemgr_ubus_notify("port.fault", poemgr_ubus_port_event(ctx, port));
+}
+
+void poemgr_ubus_notify_input(struct poemgr_ctx *ctx, struct poemgr_input_status *old_status)
+{
+	struct json_object *obj;
+
+	if (!poemgr_ubus_ctx || !poemgr_ubus_connected)
+		return;
+
+	if (old_status->type == ctx->input_status.type)
+		return;
+
+	obj = json_object_new_object();
+	json_object_object_add(obj, "type", json_object_new_string(poemgr_poe_type_to_string(ctx->input_status.type)));
+	json_object_object_add(obj, "old_type", json_object_new_string(poemgr_poe_type_to_string(old_status->type)));
+
+	poemgr_ubus_notify("input.change", obj);
+}
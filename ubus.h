@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#include "poemgr.h"
+
+#ifdef POEMGR_UBUS
+
+int poemgr_ubus_init(struct poemgr_ctx *ctx, const char *path);
+
+void poemgr_ubus_done(void);
+
+/* Socket to wait on for incoming requests, -1 if not connected */
+int poemgr_ubus_fd(void);
+
+void poemgr_ubus_handle(void);
+
+void poemgr_ubus_notify_port(struct poemgr_ctx *ctx, int port, struct poemgr_port_status *old_status);
+
+void poemgr_ubus_notify_input(struct poemgr_ctx *ctx, struct poemgr_input_status *old_status);
+
+#else
+
+static inline int poemgr_ubus_init(struct poemgr_ctx *ctx, const char *path)
+{
+	return 0;
+}
+
+static inline void poemgr_ubus_done(void)
+{
+}
+
+static inline int poemgr_ubus_fd(void)
+{
+	return -1;
+}
+
+static inline void poemgr_ubus_handle(void)
+{
+}
+
+static inline void poemgr_ubus_notify_port(struct poemgr_ctx *ctx, int port, struct poemgr_port_status *old_status)
+{
+}
+
+static inline void poemgr_ubus_notify_input(struct poemgr_ctx *ctx, struct poemgr_input_status *old_status)
+{
+}
+
+#endif
@@ -4,26 +4,22 @@
 #include <stdio.h>
 
 #include "poemgr.h"
+#include "uswflex.h"
 #include "pd69104.h"
 #include "pd69104_regs.h"
+#include "pse.h"
+#include "trace.h"
 
-#define USWLFEX_NUM_PORTS	4
+#define USWLFEX_NUM_PORTS	POEMGR_USWFLEX_NUM_PORTS
 #define USWLFEX_NUM_PSE_CHIPS	1
 #define USWLFEX_NUM_PSE_CHIP_IDX	0
 #define USWFLEX_PSE_PORTMASK	0xF
 
 #define USWLFEX_OWN_POWER_BUDGET	5	/* Own power budget */
 
-static enum poemgr_poe_type poemgr_uswflex_read_power_input(struct poemgr_ctx *ctx)
+/* Returns the PoE input type signalled on PGD[2:0] or -1 if unknown */
+static int poemgr_uswflex_pgd_to_poe_type(int reg)
 {
-	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, USWLFEX_NUM_PSE_CHIP_IDX);
-	int reg;
-
-	/* PSE has 4 input pins (4 bits in register), the USW-Flex only cares for the first 3 LSB */
-	reg = pd69104_pwrgd_pin_status_get(psechip) & 0x7;
-	if (reg < 0)
-		return -1;
-
 	switch(reg) {
 		case 0:
 		/* 1: Non-standard PoE++ */
@@ -45,6 +41,20 @@ static enum poemgr_poe_type poemgr_uswflex_read_power_input(struct poemgr_ctx *c
 	return -1;
 }
 
+/* Returns the PoE input type or -1 on error */
+static int poemgr_uswflex_read_power_input(struct poemgr_ctx *ctx)
+{
+	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, USWLFEX_NUM_PSE_CHIP_IDX);
+	int reg;
+
+	reg = pd69104_pwrgd_pin_status_get(psechip);
+	if (reg < 0)
+		return -1;
+
+	/* PSE has 4 input pins (4 bits in register), the USW-Flex only cares for the first 3 LSB */
+	return poemgr_uswflex_pgd_to_poe_type(reg & 0x7);
+}
+
 static int poemgr_uswflex_get_power_budget(enum poemgr_poe_type poe_type)
 {
 	/* Watts */
@@ -59,147 +69,165 @@ static int poemgr_uswflex_get_power_budget(enum poemgr_poe_type poe_type)
 	}
 }
 
-static int poemgr_uswflex_init_chip(struct poemgr_ctx *ctx) {
+POEMGR_PROFILE_EXPORT int poemgr_uswflex_init(struct poemgr_ctx *ctx) {
 	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, USWLFEX_NUM_PSE_CHIP_IDX);
 
 	/* Init PD69104 */
-	if (pd69104_init(psechip, 0, 0x20, USWFLEX_PSE_PORTMASK))
+	psechip->ops = &pd69104_pse_ops;
+	if (poemgr_pse_ops(psechip)->init(psechip, &ctx->arena, 0, 0x20, USWFLEX_PSE_PORTMASK))
 		return 1;
 
 	return 0;
 }
 
-static int poemgr_uswflex_ready(struct poemgr_ctx *ctx) {
+POEMGR_PROFILE_EXPORT int poemgr_uswflex_end(struct poemgr_ctx *ctx) {
+	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, USWLFEX_NUM_PSE_CHIP_IDX);
+
+	return poemgr_pse_ops(psechip)->end(psechip);
+}
+
+POEMGR_PROFILE_EXPORT int poemgr_uswflex_ready(struct poemgr_ctx *ctx) {
 	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, USWLFEX_NUM_PSE_CHIP_IDX);
 
 	/* Check if PSE is up. */
-	return pd69104_device_online(psechip);
+	return poemgr_pse_ops(psechip)->online(psechip);
 }
 
-static int poemgr_uswflex_enable_chip(struct poemgr_ctx *ctx) {
+POEMGR_PROFILE_EXPORT int poemgr_uswflex_enable(struct poemgr_ctx *ctx) {
 	int pse_reachable;
 
 	/* Check if PSE is up. Only reset the PSE chip in case the device is not reachable. */
 	pse_reachable = poemgr_uswflex_ready(ctx);
 	if (!pse_reachable) {
+		int64_t span = poemgr_trace_begin();
+
 		/* Toggle FlipFlop */
 		/* ToDo Replace this with libgpiod at some point. Not part of OpenWrt core yet. */
 		system("/usr/lib/poemgr/uswlite-pse-enable 0 &> /dev/null");
+		poemgr_trace_end(span, "gpio", "pse enable", 0);
 	}
 
 	return 0;
 }
 
-static int poemgr_uswflex_disable_chip(struct poemgr_ctx *ctx)
+POEMGR_PROFILE_EXPORT int poemgr_uswflex_disable(struct poemgr_ctx *ctx)
 {
+	int64_t span = poemgr_trace_begin();
+
 	/* Always disable chip, regardless whether it is reachable or not */
 	system("/usr/lib/poemgr/uswlite-pse-enable 1 &> /dev/null");
+	poemgr_trace_end(span, "gpio", "pse disable", 0);
 
 	return 0;
 }
 
-static int poemgr_uswflex_update_port_status(struct poemgr_ctx *ctx, int port)
+POEMGR_PROFILE_EXPORT int poemgr_uswflex_update_port_status(struct poemgr_ctx *ctx, int port)
 {
 	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, USWLFEX_NUM_PSE_CHIP_IDX);
-	struct poemgr_port_status *port_status = &ctx->ports[port].status;
 
-	port_status->power = pd69104_port_power_consumption_get(psechip, port);
-	port_status->active = pd69104_port_power_good_get(psechip, port);
-	port_status->power_limit = pd69104_port_power_limit_get(psechip, port);
-	port_status->enabled = pd69104_port_operation_mode_get(psechip, port) == PD69104_REG_OPMD_AUTO;
-	port_status->faults = pd69104_port_faults_get(psechip, port);
-	port_status->poe_class = pd69104_port_poe_class_get(psechip, port);
+	return poemgr_pse_update_port_status(psechip, port, &ctx->ports[port].status);
+}
 
-	return 0;
+static int poemgr_uswflex_read_power_budget(struct poemgr_ctx *ctx)
+{
+	int poe_type;
+
+	if (ctx->settings.power_budget > 0)
+		return ctx->settings.power_budget;
+
+	poe_type = poemgr_uswflex_read_power_input(ctx);
+	if (poe_type < 0)
+		return -1;
+
+	return poemgr_uswflex_get_power_budget(poe_type);
 }
 
-static int poemgr_uswflex_update_output_status(struct poemgr_ctx *ctx)
+POEMGR_PROFILE_EXPORT int poemgr_uswflex_update_output_status(struct poemgr_ctx *ctx)
 {
-	int poe_budget;
-	if (ctx->settings.power_budget > 0) {
-		poe_budget = ctx->settings.power_budget;
-	} else {
-		poe_budget = poemgr_uswflex_get_power_budget(poemgr_uswflex_read_power_input(ctx));
-	}
+	int poe_budget = poemgr_uswflex_read_power_budget(ctx);
+
+	if (poe_budget < 0)
+		return 1;
 
 	ctx->output_status.power_budget = poe_budget;
 
 	return 0;
 }
 
-static int poemgr_uswflex_update_input_status(struct poemgr_ctx *ctx)
+POEMGR_PROFILE_EXPORT int poemgr_uswflex_update_input_status(struct poemgr_ctx *ctx)
 {
-	ctx->input_status.type = poemgr_uswflex_read_power_input(ctx);
+	int poe_type = poemgr_uswflex_read_power_input(ctx);
+
+	if (poe_type < 0)
+		return 1;
+
+	ctx->input_status.type = poe_type;
 
 	return 0;
 }
 
-static int poemgr_uswflex_apply_config(struct poemgr_ctx *ctx)
+POEMGR_PROFILE_EXPORT int poemgr_uswflex_apply_config(struct poemgr_ctx *ctx)
 {
 	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, USWLFEX_NUM_PSE_CHIP_IDX);
-	struct poemgr_port_settings *port_settings;
-	int port_settings_available;
-	int port_opmode;
-	int ret = 0;
-
+	int bank_budgets[PD69104_REG_PWR_BNK_NUM_BANKS];
+	int poe_type;
 	int poe_budget;
-	if (ctx->settings.power_budget > 0) {
-		poe_budget = ctx->settings.power_budget;
-	} else {
-		poe_budget = poemgr_uswflex_get_power_budget(poemgr_uswflex_read_power_input(ctx));
+	int ret;
+
+	poe_budget = poemgr_uswflex_read_power_budget(ctx);
+	if (poe_budget < 0) {
+		fprintf(stderr, "Error applying configuration to PSE\n");
+		return poe_budget;
 	}
 
-	/* Set global power limit (Input - CPU)
-	 * Write this to all banks (a bank maps to the state of PGD[2:0]).
+	/* Global power limit (Input - CPU) for every input state. The PSE selects the bank
+	 * matching PGD[2:0] by itself, so the budget follows a changing input without apply.
 	 */
 	for (int i = 0; i < PD69104_REG_PWR_BNK_NUM_BANKS; i++) {
-		ret = pd69104_system_power_budget_set(psechip, i, poe_budget);
-		if (ret < 0)
-			goto out;
+		bank_budgets[i] = ctx->settings.power_budget;
+		if (bank_budgets[i] > 0)
+			continue;
+
+		/* Unknown inputs get the most conservative budget */
+		poe_type = poemgr_uswflex_pgd_to_poe_type(i);
+		bank_budgets[i] = poemgr_uswflex_get_power_budget(poe_type < 0 ? POEMGR_POE_TYPE_AF : poe_type);
 	}
 
-	for (int i = 0; i < USWLFEX_NUM_PORTS; i++) {
-		/* Apply settings */
-		port_settings = &ctx->ports[i].settings;
-		port_settings_available = !!port_settings->name;
-
-		/* Set port operation mode */
-		port_opmode = PD69104_REG_OPMD_AUTO;
-		if (port_settings->disabled || !port_settings_available)
-			port_opmode = PD69104_REG_OPMD_SHUTDOWN;
-		ret = pd69104_port_operation_mode_set(psechip, i, port_opmode);
-		if (ret < 0)
-			goto out;
-
-		/* Shutdown implicitly disables detection as well as classification */
-		if (port_opmode != PD69104_REG_OPMD_SHUTDOWN) {
-			ret = pd69104_port_detection_classification_set(psechip, i, 1);
-			if (ret < 0)
-				goto out;
-		}
-
-		/* Set output limit per port */
-		ret = pd69104_port_power_limit_set(psechip, i, poe_budget);
-		if (ret < 0)
-			goto out;
+	ret = poemgr_pse_apply_config(ctx, psechip, poe_budget, bank_budgets);
+	if (ret)
+		fprintf(stderr, "Error applying configuration to PSE\n");
 
-	}
+	return ret;
+}
 
-	/* ToDo: Set output priority */
-out:
-	return 0;
+POEMGR_PROFILE_EXPORT int poemgr_uswflex_set_ports_power(struct poemgr_ctx *ctx, uint32_t portmask, int enable)
+{
+	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, USWLFEX_NUM_PSE_CHIP_IDX);
+
+	return poemgr_pse_ops(psechip)->set_port_mode(psechip, portmask,
+					   enable ? POEMGR_PSE_PORT_MODE_AUTO : POEMGR_PSE_PORT_MODE_OFF);
+}
+
+POEMGR_PROFILE_EXPORT int poemgr_uswflex_get_ports_power_good(struct poemgr_ctx *ctx)
+{
+	struct poemgr_pse_chip *psechip = poemgr_profile_pse_chip_get(ctx->profile, USWLFEX_NUM_PSE_CHIP_IDX);
+
+	return poemgr_pse_ops(psechip)->get_power_good(psechip);
 }
 
 struct poemgr_profile poemgr_profile_uswflex = {
 	.name = "usw-flex",
 	.num_ports = USWLFEX_NUM_PORTS,
 	.ready = &poemgr_uswflex_ready,
-	.enable = &poemgr_uswflex_enable_chip,
-	.disable = &poemgr_uswflex_disable_chip,
-	.init = &poemgr_uswflex_init_chip,
+	.enable = &poemgr_uswflex_enable,
+	.disable = &poemgr_uswflex_disable,
+	.init = &poemgr_uswflex_init,
+	.end = &poemgr_uswflex_end,
 	.apply_config = &poemgr_uswflex_apply_config,
 	.update_port_status = &poemgr_uswflex_update_port_status,
 	.update_output_status = &poemgr_uswflex_update_output_status,
 	.update_input_status = &poemgr_uswflex_update_input_status,
+	.set_ports_power = &poemgr_uswflex_set_ports_power,
+	.get_ports_power_good = &poemgr_uswflex_get_ports_power_good,
 	.num_pse_chips = USWLFEX_NUM_PSE_CHIPS,
 };
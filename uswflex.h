@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#pragma once
+
+#define POEMGR_USWFLEX_NUM_PORTS	4
+
+#ifdef POEMGR_PROFILE
+
+#include <stdint.h>
+
+struct poemgr_ctx;
+struct poemgr_pse_ops;
+
+/* Callbacks of the single-profile build */
+#define poemgr_uswflex_num_ports	POEMGR_USWFLEX_NUM_PORTS
+
+int poemgr_uswflex_init(struct poemgr_ctx *ctx);
+int poemgr_uswflex_end(struct poemgr_ctx *ctx);
+int poemgr_uswflex_ready(struct poemgr_ctx *ctx);
+int poemgr_uswflex_enable(struct poemgr_ctx *ctx);
+int poemgr_uswflex_disable(struct poemgr_ctx *ctx);
+int poemgr_uswflex_apply_config(struct poemgr_ctx *ctx);
+int poemgr_uswflex_update_port_status(struct poemgr_ctx *ctx, int port);
+int poemgr_uswflex_update_input_status(struct poemgr_ctx *ctx);
+int poemgr_uswflex_update_output_status(struct poemgr_ctx *ctx);
+int poemgr_uswflex_set_ports_power(struct poemgr_ctx *ctx, uint32_t portmask, int enable);
+int poemgr_uswflex_get_ports_power_good(struct poemgr_ctx *ctx);
+
+/* Driver of the only PSE chip */
+extern const struct poemgr_pse_ops pd69104_pse_ops;
+#define POEMGR_PROFILE_PSE_OPS		pd69104_pse_ops
+
+#endif